@@ -0,0 +1,425 @@
+/*
+ * bench.c - Cycle and stack benchmark of the firmware hot paths
+ *
+ * Replaces main() of the firmware (main.c is built with main renamed to
+ * fw_main, see Makefile) and runs each case of BENCH_CASES once:
+ *
+ * 		1. prep_x() sets up inputs and peripheral flags
+ * 		2. the stack below SP is painted with BENCH_FILL
+ * 		3. run_x() is timed with TA0 counting MCLK
+ * 		4. the painted area is scanned for the deepest overwritten byte
+ *
+ * The timing and stack of an empty case (nop) are subtracted, so a result
+ * is the cost of the call itself. ISRs are entered through benchIsr(),
+ * which stacks PC and SR like the hardware so their RETI returns here;
+ * their cycles include that entry (about the 6 cycles of a real one).
+ *
+ * Results go to benchResult[] and benchDone() is called. Under an
+ * instruction set simulator (make run: mspdebug's sim driver or iss430.c)
+ * the Makefile breaks there and dumps benchResult, on a LaunchPad built
+ * with BENCH_UART=1 they are also sent as "name,cycles,stack" lines at
+ * 9600 baud. The peripherals are not driven: DOUT and the DHT11 line read as
+ * whatever the port registers hold, so the HX711 paths see all-zero bits.
+ * Each case must take less than 131072 cycles.
+ *
+ */
+
+#include "hal.h"
+#include "loadCellFunks.h"
+#include "serial_handler.h"
+#include "thFunks.h"
+#include "frameFunks.h"
+#include "filtFunks.h"
+#include "burstFunks.h"
+#include "deltaFunks.h"
+#include "fmtFunks.h"
+#include "ctrlFunks.h"
+#include "profFunks.h"
+#include "calFunks.h"
+#include "tcFunks.h"
+
+#define		BENCH_FILL		0xA5
+#define		BENCH_PAINT		96			// bytes painted below SP, must stay above .bss
+#define		BENCH_WRAP		0x01		// TA0 wrapped during the case, cycles += 65536
+
+// main.c has no header
+void num2str24(long int, unsigned char);
+void th2str(volatile char*);
+void volt2str(unsigned int);
+void pulseOut(char*);
+int cmdNum(char*);
+void config(char*);
+void calConfig(char*);
+void sampleSend(void);
+void clockInit(void);
+void Timer1_A1(void);
+void Timer_A0(void);
+void Timer_A1(void);
+void Port_1(void);
+void Port_2(void);
+void ADC10_ISR(void);
+void USCI0RX_ISR(void);
+void USCI0TX_ISR(void);
+
+extern volatile char thRaw[5];
+extern volatile unsigned char thEdgeCnt, thState;
+extern unsigned char hxSettle;
+extern volatile unsigned char tx_head, tx_tail;
+
+typedef struct {
+	unsigned int cycles;
+	unsigned char stack, flags;
+} benchRes;
+
+long int benchIn[HX_CELLS], benchOut[HX_CELLS];
+char benchCmd[] = "F053", benchTare[] = "X", benchSched[] = "C128,064,032";
+volatile long int benchVal = 1234567;
+volatile int benchVal3 = 471;
+unsigned char benchStr[8];
+
+
+/*
+ *  === benchIsr ===
+ *
+ *  Calls an interrupt handler as the CPU would: pushes the return address
+ *  and SR, then jumps to it. GCC syntax, small memory model.
+ *
+ */
+static void benchIsr(void (*isr)(void)){
+#ifdef HOST_SIM
+	isr();
+#else
+	__asm__ __volatile__(
+			"push	#1f\n\t"
+			"push	r2\n\t"
+			"br		%0\n"
+			"1:\n"
+			: : "r"(isr) : "memory");
+#endif
+}
+
+static void benchLoads(long int v){
+	unsigned char c;
+	for(c=0; c<HX_CELLS; c++)(benchIn[c] = v + 1000*c);
+}
+
+
+/*
+ * ------------------------------ Cases --------------------------------
+ */
+static void prep_none(void){ }
+
+static void run_nop(void){ }
+
+static void run_readCells(void){ readCells(HI_GAIN, benchOut); }
+
+static void prep_hxIsr(void){
+	P1IE |= SDI;
+	P1IFG |= SDI;
+	hxSettle = 0;
+}
+static void run_hxIsr(void){ benchIsr(Port_1); }
+
+static void prep_hxPop(void){ prep_hxIsr(); benchIsr(Port_1); }
+static void run_hxPop(void){ unsigned char s; hxPop(benchOut, &s); }
+
+static void prep_port2(void){
+	P2IE |= HX_P2_PINS;
+	P2IFG |= HX_P2_PINS;
+	hxSettle = 0;
+}
+static void run_port2(void){ benchIsr(Port_2); }
+
+static void run_num2str24(void){ num2str24(-1234567, 0); }
+
+// fmtDec against the / and % loops it replaced in num2str24 and th2str
+static void __attribute__((noinline)) divMod8(long int v, unsigned char* dst){
+	unsigned char i;
+	for(i=8; i>0; i--){
+		dst[i-1] = (v % 10)+'0';
+		v /= 10;
+	}
+}
+static void __attribute__((noinline)) divMod3(int v, unsigned char* dst){
+	dst[2] = v%10+'0';
+	v /= 10;
+	dst[1] = v%10+'0';
+	v /= 10;
+	dst[0] = v%10+'0';
+}
+static void run_fmtDec8(void){ fmtDec(benchVal, benchStr, 8); }
+static void run_divMod8(void){ divMod8(benchVal, benchStr); }
+static void run_fmtDec3(void){ fmtDec(benchVal3, benchStr, 3); }
+static void run_divMod3(void){ divMod3(benchVal3, benchStr); }
+static void run_volt2str(void){ volt2str(11840); }
+
+static void prep_th(void){
+	thRaw[0] = 47; thRaw[1] = 5; thRaw[2] = 23; thRaw[3] = 8;
+	thRaw[4] = 47+5+23+8;
+	thStatus = TH_OK;
+}
+static void run_thRead(void){ thRead(); }
+static void run_th2str(void){ th2str(thBuffer); }
+
+static void prep_thEdge(void){
+	P1IE = DATA;
+	P1IFG = DATA;
+	thEdgeCnt = 10;
+}
+static void run_thEdge(void){ benchIsr(Port_1); }
+
+static void run_pulseOut(void){ pulseOut(benchCmd); }
+static void run_cmdNum(void){ cmdNum(benchCmd); }
+
+static void prep_filt(void){
+	filtConfig(1, 7);
+	benchLoads(150000);
+}
+static void run_filtPush(void){ filtPush(benchIn, benchOut); }
+
+static void run_frameSample(void){ frameSample(benchIn, thBuffer, 11840, 0, 1, 0x12345678); }
+static void run_crc8(void){ crc8(tx_data_str, 20); }
+
+static void prep_burst(void){ burstReset(); benchLoads(150000); }
+static void run_burstPush(void){ burstPush(benchIn, 0); }
+
+static void prep_delta(void){
+	deltaReset();
+	benchLoads(150000);
+	deltaPush(benchIn, 0);			// keyframe
+	benchLoads(150013);
+}
+static void run_deltaPush(void){ deltaPush(benchIn, 0); }
+
+static void prep_trig(void){
+	unsigned char i;
+	trigArm(TRIG_SLOPE);
+	benchLoads(150000);
+	for(i=0; i<TRIG_PRE; i++)(trigPush(benchIn, HX_SRC(hxSched[0])));
+}
+static void run_trigPush(void){ trigPush(benchIn, HX_SRC(hxSched[0])); }
+
+static void prep_ctrl(void){
+	ctrlGains(40, 1);
+	ctrlStart(400);
+	benchLoads(150000);
+}
+static void run_ctrlStep(void){ ctrlStep(benchIn); }
+
+static calRecord benchCal;
+static void prep_cal(void){
+	unsigned char c;
+
+	for(c=0; c<HX_CELLS; c++){
+		benchCal.ofs[c] = -5000;
+		benchCal.gain[c] = -0x5A5A;
+		benchCal.shift[c] = 20;
+	}
+	benchCal.unit = CAL_MN;				// the longer path
+	calRec = &benchCal;
+	benchLoads(150000);
+}
+static void run_calApply(void){ calApply(benchIn, benchOut); }
+
+// a table in segment B (replaces the one there on a LaunchPad), halfway up a ramp between two points
+static void prep_tc(void){
+	unsigned char c, i;
+
+	if(tcState == TC_OFF){
+		tcBegin(150, 30, 0);
+		for(c=0; c<HX_CELLS; c++){
+			for(i=0; i<TC_N; i++)(tcPoint(c, i, 100*i - 300));
+		}
+		tcEnd();
+	}
+	thBuffer[2] = 0;
+	thBuffer[3] = 200;					// 20.0 C
+	tcReading(200, 0, 10 << 8);
+	thBuffer[3] = 215;
+	tcReading(200, 0, 10 << 8);
+	benchLoads(150000);
+}
+static void run_tcApply(void){ tcApply(benchIn, benchOut, 5UL << 16, 10 << 8); }
+
+static void prep_t0a0(void){
+	profConfig(PROF_SCURVE, 100);
+	profStart(400);
+	TA0CCTL0 |= CCIFG;
+}
+static void run_t0a0(void){ benchIsr(Timer_A0); }
+
+static void prep_t1a1(void){
+	TA1CCTL1 |= CCIFG;
+#ifndef HOST_SIM
+	TA1IV = TA1IV_TACCR1;			// only sticks in an ISS, hardware derives it
+#endif
+}
+static void run_t1a1(void){ benchIsr(Timer1_A1); }
+
+static void prep_t1a0(void){ thState = 3; }
+static void run_t1a0(void){ benchIsr(Timer_A1); }
+
+static void prep_rx(void){ IFG2 |= UCA0RXIFG; }
+static void run_rx(void){ benchIsr(USCI0RX_ISR); }
+
+static void prep_tx(void){ uart_queue((unsigned char*)benchCmd, 1); IE2 &= ~UCA0TXIE; }
+static void run_tx(void){ benchIsr(USCI0TX_ISR); }
+
+static void run_adc(void){ benchIsr(ADC10_ISR); }
+
+// the deepest paths from the mainloop, for make ramcheck: a frame of compensated grams, a tare writes info flash
+static void prep_sample(void){
+	prep_tc();
+	prep_cal();
+	tx_tail = tx_head;					// room for the frame
+}
+static void run_sampleSend(void){ sampleSend(); }
+static void run_cmdTare(void){ calConfig(benchTare); }
+static void run_cmdSched(void){ config(benchSched); }
+
+
+// name, prep, run; nop must stay first
+#define BENCH_CASES \
+	B(nop,			prep_none,		run_nop) \
+	B(readCells,	prep_none,		run_readCells) \
+	B(isr_hx,		prep_hxIsr,		run_hxIsr) \
+	B(hxPop,		prep_hxPop,		run_hxPop) \
+	B(isr_port2,	prep_port2,		run_port2) \
+	B(num2str24,	prep_none,		run_num2str24) \
+	B(fmtDec8,		prep_none,		run_fmtDec8) \
+	B(divMod8,		prep_none,		run_divMod8) \
+	B(fmtDec3,		prep_none,		run_fmtDec3) \
+	B(divMod3,		prep_none,		run_divMod3) \
+	B(volt2str,		prep_none,		run_volt2str) \
+	B(thRead,		prep_th,		run_thRead) \
+	B(th2str,		prep_th,		run_th2str) \
+	B(isr_thEdge,	prep_thEdge,	run_thEdge) \
+	B(pulseOut,		prep_none,		run_pulseOut) \
+	B(cmdNum,		prep_none,		run_cmdNum) \
+	B(filtPush,		prep_filt,		run_filtPush) \
+	B(frameSample,	prep_none,		run_frameSample) \
+	B(crc8,			prep_none,		run_crc8) \
+	B(burstPush,	prep_burst,		run_burstPush) \
+	B(deltaPush,	prep_delta,		run_deltaPush) \
+	B(trigPush,		prep_trig,		run_trigPush) \
+	B(ctrlStep,		prep_ctrl,		run_ctrlStep) \
+	B(calApply,		prep_cal,		run_calApply) \
+	B(tcApply,		prep_tc,		run_tcApply) \
+	B(isr_t0a0,		prep_t0a0,		run_t0a0) \
+	B(isr_t1a1,		prep_t1a1,		run_t1a1) \
+	B(isr_t1a0,		prep_t1a0,		run_t1a0) \
+	B(isr_uartRx,	prep_rx,		run_rx) \
+	B(isr_uartTx,	prep_tx,		run_tx) \
+	B(isr_adc,		prep_none,		run_adc) \
+	B(sampleSend,	prep_sample,	run_sampleSend) \
+	B(cmdTare,		prep_none,		run_cmdTare) \
+	B(cmdSched,		prep_none,		run_cmdSched)
+
+typedef struct {
+	const char* name;
+	void (*prep)(void);
+	void (*run)(void);
+} benchCase;
+
+#define B(n, p, r)	{ #n, p, r },
+const benchCase benchCases[] = { BENCH_CASES };
+#undef B
+
+#define BENCH_N		(sizeof(benchCases)/sizeof(benchCases[0]))
+
+benchRes benchResult[BENCH_N];
+
+
+/*
+ *  === benchOne ===
+ *
+ *  Measures case n. Interrupts stay disabled; cases that enable them
+ *  (readCells nests in the CLK low phases) find no other interrupt pending.
+ *
+ */
+static void benchOne(unsigned char n){
+	unsigned char* sp;
+	unsigned char* p;
+	unsigned int t0, t1;
+	unsigned char wrap;
+
+	benchCases[n].prep();
+
+	sp = (unsigned char*)__get_SP_register();
+	for(p = sp - BENCH_PAINT; p < sp; p++){
+		*p = BENCH_FILL;
+	}
+
+	TA0CTL = TASSEL_2 | MC_2 | ID_0 | TACLR;		// SMCLK = MCLK until clockInit()
+	TA0CTL &= ~TAIFG;
+	t0 = TA0R;
+	benchCases[n].run();
+	t1 = TA0R;
+	wrap = TA0CTL & TAIFG;
+	TA0CTL = MC_0;
+	__disable_interrupt();
+
+	for(p = sp - BENCH_PAINT; p < sp && *p == BENCH_FILL; p++);
+
+	benchResult[n].cycles = t1 - t0;
+	benchResult[n].stack = sp - p;
+	benchResult[n].flags = (wrap || t1 < t0) ? BENCH_WRAP : 0;
+	if(n){
+		benchResult[n].cycles -= benchResult[0].cycles;
+		benchResult[n].stack -= benchResult[0].stack;
+	}
+}
+
+
+/*
+ *  === benchDone ===
+ *
+ *  Breakpoint for the simulator run, benchResult is complete.
+ *
+ */
+void __attribute__((noinline)) benchDone(void){
+	__no_operation();
+}
+
+
+int main(void){
+	unsigned char n;
+
+	WDTCTL = WDTPW + WDTHOLD;
+	__disable_interrupt();
+	loadCellInit();
+	thInit();
+	filtConfig(1, 0);
+
+	for(n=0; n<BENCH_N; n++){
+		benchOne(n);
+		P1IE = 0;
+		P2IE = 0;
+		IE2 = 0;
+	}
+	benchDone();
+
+#ifdef BENCH_UART
+	clockInit();
+	uart_init(4);								// 9600 baud
+	for(n=0; n<BENCH_N; n++){
+		unsigned char leng = 0;
+		const char* s;
+
+		for(s=benchCases[n].name; *s; s++)(tx_data_str[leng++] = *s);
+		tx_data_str[leng++] = ',';
+		fmtDec(benchResult[n].cycles + (benchResult[n].flags & BENCH_WRAP ? 65536UL : 0), &tx_data_str[leng], 6);
+		leng += 6;
+		tx_data_str[leng++] = ',';
+		fmtDec(benchResult[n].stack, &tx_data_str[leng], 3);
+		leng += 3;
+		uart_write_string(0, leng);
+		uart_tx_flush();
+	}
+#endif
+
+#ifdef HOST_SIM
+	return 0;						// sim prints its report on exit
+#endif
+	while(1);
+}
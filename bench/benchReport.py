@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Turn the benchResult dump of a bench run into CSV, compare two runs, or
+add up the firmware's worst case stack.
+
+    benchReport.py bench.c bench.log > bench.csv
+    benchReport.py --check baseline.csv bench.csv
+    benchReport.py --stack bench.csv main.su
+
+bench.log is mspdebug's output of "md benchResult ...": per case a 16 bit
+cycle count, the stack depth and flags (bit 0: TA0 wrapped), in the order
+of BENCH_CASES in bench.c. --check exits with 1 if a case got more than
+CYCLE_TOL slower or STACK_TOL bytes deeper than the baseline. Lines of a
+CSV starting with # are comments (make baseline notes the toolchain).
+
+--stack prints the deepest the stack can get, for make ramcheck: the
+return address of main, its frame (from the -fstack-usage output of
+main.c), the deepest case run from the mainloop, the HX711 interrupt
+(isr_hx or isr_port2), which runs with interrupts enabled while CLK is
+low, and the deepest other interrupt nested in it.
+"""
+
+import re
+import sys
+
+CYCLE_TOL = 0.05
+STACK_TOL = 2
+
+
+def case_names(src):
+    text = open(src).read()
+    body = text[text.index('#define BENCH_CASES'):]
+    body = body[:body.index('typedef')]
+    return re.findall(r'B\((\w+),', body)
+
+
+def dump_bytes(log):
+    data = []
+    for line in open(log):
+        m = re.match(r'\s*(?:0x)?[0-9a-fA-F]+:\s+((?:[0-9a-fA-F]{2}\s)+)', line)
+        if m:
+            data += [int(b, 16) for b in m.group(1).split()]
+    return data
+
+
+def report(src, log):
+    names = case_names(src)
+    data = dump_bytes(log)
+    if len(data) < 4 * len(names):
+        sys.exit('bench.log holds %d bytes, %d cases need %d' % (len(data), len(names), 4 * len(names)))
+    print('name,cycles,stack')
+    for i, name in enumerate(names):
+        cycles = data[4*i] | data[4*i+1] << 8
+        stack, flags = data[4*i+2], data[4*i+3]
+        if flags & 1:
+            cycles += 65536
+        print('%s,%d,%d' % (name, cycles, stack))
+
+
+def load(csv):
+    rows = {}
+    lines = [l for l in open(csv).read().split('\n') if l and not l.startswith('#')]
+    for line in lines[1:]:
+        name, cycles, stack = line.split(',')
+        rows[name] = (int(cycles), int(stack))
+    return rows
+
+
+def check(base_csv, new_csv):
+    base, new = load(base_csv), load(new_csv)
+    bad = 0
+    for name, (cycles, stack) in new.items():
+        if name not in base:
+            print('%-14s new case, %d cycles, %d bytes' % (name, cycles, stack))
+            continue
+        bc, bs = base[name]
+        worse = cycles > bc * (1 + CYCLE_TOL) or stack > bs + STACK_TOL
+        bad += worse
+        print('%-14s %7d -> %7d cycles  %4d -> %4d bytes%s' % (
+            name, bc, cycles, bs, stack, '  REGRESSION' if worse else ''))
+    return 1 if bad else 0
+
+
+def stack(csv, su):
+    rows = load(csv)
+    frame = [int(l.split('\t')[1]) for l in open(su) if l.split('\t')[0].endswith(':main')]
+    if not frame:
+        sys.exit('%s: no frame of main' % su)
+    loop = max(s for name, (c, s) in rows.items() if not name.startswith('isr_'))
+    hx = max(rows['isr_hx'][1], rows['isr_port2'][1])
+    isr = max(s for name, (c, s) in rows.items() if name.startswith('isr_') and name not in ('isr_hx', 'isr_port2'))
+    return 2 + frame[0] + loop + hx + isr
+
+
+if __name__ == '__main__':
+    if len(sys.argv) == 4 and sys.argv[1] == '--check':
+        sys.exit(check(sys.argv[2], sys.argv[3]))
+    if len(sys.argv) == 4 and sys.argv[1] == '--stack':
+        print(stack(sys.argv[2], sys.argv[3]))
+        sys.exit(0)
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    report(sys.argv[1], sys.argv[2])
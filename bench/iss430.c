@@ -0,0 +1,637 @@
+/*
+ * iss430.c - Cycle counting MSP430 instruction set simulator for the bench
+ *
+ *   iss430 [-c max-cycles] [-t] file.elf break-symbol dump-symbol [bytes]
+ *
+ * Loads the program headers of an MSP430 ELF file at their physical
+ * addresses, starts at the reset vector and runs until the PC reaches
+ * break-symbol. It then prints the bytes of dump-symbol (its size unless
+ * given) like mspdebug's "md", which is what benchReport.py reads:
+ *
+ *   make run SIM=iss
+ *
+ * It is a stand-in for "mspdebug sim" where that is not installed, with
+ * just what the bench needs:
+ *
+ * 		CPU		the MSP430 (not MSP430X) instruction set, cycles per
+ * 				instruction as in the family guide (SLAU144, 3.4.4)
+ * 		Timer_A	TA0 and TA1 count SMCLK (= MCLK / DIVS) in stop, up,
+ * 				continuous and up/down mode, with ID, TACLR and TAIFG
+ * 		flash	the controller erases segments and programs bytes and
+ * 				words, holding the CPU as long as the real one does;
+ * 				other writes to flash are ignored
+ *
+ * Everything else reads back what was last written. Interrupts are not
+ * delivered (the bench calls its handlers directly, with GIE off), and a
+ * CPUOFF with GIE clear stops the run as a hang. -t prints every
+ * instruction's address and cycle count. Exits with 1 on an illegal
+ * instruction, a hang or after max-cycles (default 10^9).
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define		SR_C		0x0001
+#define		SR_Z		0x0002
+#define		SR_N		0x0004
+#define		SR_GIE		0x0008
+#define		SR_CPUOFF	0x0010
+#define		SR_V		0x0100
+
+#define		BCSCTL2		0x0058
+#define		FCTL1		0x0128
+#define		FCTL2		0x012A
+#define		FCTL3		0x012C
+#define		FLASH_LOCK	0x10
+
+typedef struct {
+	unsigned int ctl, tar, ccr0;		// register addresses
+	unsigned long div;					// input clocks not yet counted
+	int down;							// up/down mode, counting down
+} issTimer;
+
+unsigned char mem[0x10000];
+unsigned int reg[16];
+unsigned long long cycles = 0;
+issTimer timers[2] = {{0x0160, 0x0170, 0x0172}, {0x0180, 0x0190, 0x0192}};
+int trace = 0;
+
+
+/*
+ * ------------------------------ Memory --------------------------------
+ */
+int isFlash(unsigned int a){
+	return (a >= 0x1000 && a < 0x1100) || a >= 0xC000;
+}
+
+unsigned int rd16(unsigned int a){
+	a &= 0xFFFE;
+	return mem[a] | mem[a+1] << 8;
+}
+
+void wr16raw(unsigned int a, unsigned int v){
+	a &= 0xFFFE;
+	mem[a] = v;
+	mem[a+1] = v >> 8;
+}
+
+/*
+ *  === flashWrite ===
+ *
+ *  A write to flash: erases the segment after a dummy write with ERASE
+ *  set, programs with WRT set, and is ignored otherwise or when LOCK is
+ *  set. The CPU is held for the flash timing generator cycles of the
+ *  operation (4819 per erase, 35 per byte, as in SLAU144 7.3.2).
+ *
+ */
+void flashWrite(unsigned int a, unsigned int v, int word){
+	unsigned int fctl1 = rd16(FCTL1), fctl2 = rd16(FCTL2), fctl3 = rd16(FCTL3);
+	unsigned int seg, leng, i, ftg = (fctl2 & 0x3F) + 1;
+
+	if(fctl3 & FLASH_LOCK){
+		return;
+	}
+	if(fctl1 & 0x06){					// ERASE or MERAS
+		leng = (a < 0x1100) ? 64 : 512;
+		seg = a & ~(leng-1);
+		for(i=0; i<leng; i++)(mem[seg+i] = 0xFF);
+		cycles += 4819UL*ftg;
+	}
+	else if(fctl1 & 0xC0){				// WRT or BLKWRT, bits can only be cleared
+		if(word){
+			mem[a & 0xFFFE] &= v;
+			mem[(a & 0xFFFE)+1] &= v >> 8;
+		}
+		else{
+			mem[a] &= v;
+		}
+		cycles += 35UL*ftg;
+	}
+}
+
+/*
+ *  === timerWrite ===
+ *
+ *  TACLR clears TAR and the divider and reads back as 0.
+ *
+ */
+void timerWrite(unsigned int a){
+	int t;
+
+	for(t=0; t<2; t++){
+		if((a & 0xFFFE) == timers[t].ctl && (rd16(a) & 0x0004)){
+			wr16raw(timers[t].ctl, rd16(a) & ~0x0004);
+			wr16raw(timers[t].tar, 0);
+			timers[t].div = 0;
+			timers[t].down = 0;
+		}
+	}
+}
+
+void wr8(unsigned int a, unsigned int v){
+	if(isFlash(a)){
+		flashWrite(a, v & 0xFF, 0);
+		return;
+	}
+	if(a == FCTL1 || a == FCTL2 || a == FCTL3){
+		return;							// word access only
+	}
+	mem[a] = v;
+	timerWrite(a);
+}
+
+void wr16(unsigned int a, unsigned int v){
+	a &= 0xFFFE;
+	if(isFlash(a)){
+		flashWrite(a, v, 1);
+		return;
+	}
+	if(a == FCTL1 || a == FCTL2 || a == FCTL3){
+		if((v >> 8) == 0xA5)(wr16raw(a, 0x9600 | (v & 0xFF)));	// FWKEY, reads back FRKEY
+		return;
+	}
+	wr16raw(a, v);
+	timerWrite(a);
+}
+
+
+/*
+ * ------------------------------ Timers --------------------------------
+ */
+
+/*
+ *  === timerRun ===
+ *
+ *  Advances TA0 and TA1 by n MCLK cycles.
+ *
+ */
+void timerRun(unsigned long n){
+	unsigned int ctl, tar, ccr0, mc, id;
+	unsigned long ticks;
+	int t;
+
+	for(t=0; t<2; t++){
+		ctl = rd16(timers[t].ctl);
+		mc = (ctl >> 4) & 3;
+		if(mc == 0 || ((ctl >> 8) & 3) != 2){		// stopped, or not on SMCLK
+			continue;
+		}
+		id = ((ctl >> 6) & 3) + ((mem[BCSCTL2] >> 1) & 3);	// ID and DIVS dividers
+		timers[t].div += n;
+		ticks = timers[t].div >> id;
+		timers[t].div -= ticks << id;
+
+		tar = rd16(timers[t].tar);
+		ccr0 = rd16(timers[t].ccr0);
+		while(ticks--){
+			if(mc == 2 || (mc == 1 && tar < ccr0)){
+				tar = (tar+1) & 0xFFFF;
+				if(tar == 0)(ctl |= 0x0001);	// TAIFG
+			}
+			else if(mc == 1){
+				tar = 0;
+				ctl |= 0x0001;
+			}
+			else if(!timers[t].down){			// up/down
+				if(tar < ccr0)(tar++);
+				else{
+					timers[t].down = 1;
+					tar--;
+				}
+			}
+			else{
+				if(tar > 0)(tar--);
+				if(tar == 0){
+					timers[t].down = 0;
+					ctl |= 0x0001;
+				}
+			}
+		}
+		wr16raw(timers[t].tar, tar);
+		wr16raw(timers[t].ctl, ctl);
+	}
+}
+
+
+/*
+ * ------------------------------- CPU ---------------------------------
+ */
+
+// an operand: a register (reg >= 0), a memory address or a constant
+typedef struct {
+	int reg;
+	unsigned int addr, val;
+	int isConst;
+} issOp;
+
+unsigned int fetch(void){
+	unsigned int w = rd16(reg[0]);
+	reg[0] = (reg[0]+2) & 0xFFFF;
+	return w;
+}
+
+/*
+ *  === source ===
+ *
+ *  Decodes source mode as of register r and reads the operand. Returns
+ *  the addressing mode for the cycle table: 0 register or constant,
+ *  1 indexed/symbolic/absolute, 2 indirect, 3 autoincrement, 4 immediate.
+ *
+ */
+int source(int as, int r, int bw, issOp* op){
+	op->reg = -1;
+	op->isConst = 0;
+	if(r == 3 || (r == 2 && as >= 2)){		// constant generators
+		static const unsigned int cg2[4] = {0, 1, 2, 0xFFFF}, cg1[4] = {0, 0, 4, 8};
+		op->val = (r == 3) ? cg2[as] : cg1[as];
+		if(bw)(op->val &= 0xFF);
+		op->isConst = 1;
+		return 0;
+	}
+	switch(as){
+	case 0:
+		op->reg = r;
+		op->val = bw ? reg[r] & 0xFF : reg[r];
+		return 0;
+	case 1:
+		op->addr = (r == 2) ? 0 : reg[r];
+		op->addr = (op->addr + fetch()) & 0xFFFF;
+		if(r == 0)(op->addr = (op->addr - 2) & 0xFFFF);	// symbolic: from the index word
+		break;
+	case 2:
+		op->addr = reg[r];
+		break;
+	default:
+		op->addr = reg[r];
+		reg[r] = (reg[r] + ((bw && r > 1) ? 1 : 2)) & 0xFFFF;
+		break;
+	}
+	op->val = bw ? mem[op->addr] : rd16(op->addr);
+	return (as == 3 && r == 0) ? 4 : (as == 1 ? 1 : as);
+}
+
+/*
+ *  === dest ===
+ *
+ *  Decodes destination mode ad of register r, reads the operand if
+ *  needed. Returns 0 for a register, 1 for memory.
+ *
+ */
+int dest(int ad, int r, int bw, issOp* op){
+	op->isConst = 0;
+	if(ad == 0){
+		op->reg = r;
+		op->val = bw ? reg[r] & 0xFF : reg[r];
+		return 0;
+	}
+	op->reg = -1;
+	op->addr = (r == 2) ? 0 : reg[r];
+	op->addr = (op->addr + fetch()) & 0xFFFF;
+	if(r == 0)(op->addr = (op->addr - 2) & 0xFFFF);
+	op->val = bw ? mem[op->addr] : rd16(op->addr);
+	return 1;
+}
+
+void store(issOp* op, int bw, unsigned int v){
+	if(op->reg >= 0){
+		if(op->reg != 3)(reg[op->reg] = bw ? v & 0xFF : v & 0xFFFF);
+	}
+	else if(bw){
+		wr8(op->addr, v);
+	}
+	else{
+		wr16(op->addr, v);
+	}
+}
+
+void flags(unsigned int res, int bw, int c, int v){
+	unsigned int msb = bw ? 0x80 : 0x8000, mask = bw ? 0xFF : 0xFFFF;
+
+	reg[2] &= ~(SR_C | SR_Z | SR_N | SR_V);
+	if((res & mask) == 0)(reg[2] |= SR_Z);
+	if(res & msb)(reg[2] |= SR_N);
+	if(c)(reg[2] |= SR_C);
+	if(v)(reg[2] |= SR_V);
+}
+
+unsigned int addFlags(unsigned int a, unsigned int b, unsigned int cin, int bw){
+	unsigned int msb = bw ? 0x80 : 0x8000, mask = bw ? 0xFF : 0xFFFF;
+	unsigned int res = (a & mask) + (b & mask) + cin;
+
+	flags(res, bw, res > mask, ((a ^ res) & (b ^ res) & msb) != 0);
+	return res & mask;
+}
+
+unsigned int dadd(unsigned int a, unsigned int b, int bw){
+	unsigned int res = 0, c = reg[2] & SR_C, d, i, n = bw ? 2 : 4;
+
+	for(i=0; i<n; i++){
+		d = ((a >> 4*i) & 15) + ((b >> 4*i) & 15) + c;
+		c = d > 9;
+		if(c)(d -= 10);
+		res |= d << 4*i;
+	}
+	flags(res, bw, c, 0);
+	return res;
+}
+
+// SLAU144 table 3-16, by source mode and destination register / PC / memory
+const unsigned char cyclesI[5][3] = {
+		{1, 2, 4},		// Rn, constants
+		{3, 3, 6},		// x(Rn), EDE, &EDE
+		{2, 2, 5},		// @Rn
+		{2, 3, 5},		// @Rn+
+		{2, 3, 5}		// #N
+};
+// table 3-15: RRA/RRC/SWPB/SXT, PUSH, CALL by mode
+const unsigned char cyclesII[5][3] = {
+		{1, 3, 4},
+		{4, 5, 5},
+		{3, 4, 4},
+		{3, 5, 5},
+		{0, 4, 5}
+};
+
+/*
+ *  === step ===
+ *
+ *  Executes one instruction. Returns its cycles, 0 if it is illegal.
+ *
+ */
+int step(void){
+	unsigned int pc = reg[0], w = fetch(), v, res, c;
+	int bw = (w >> 6) & 1, as = (w >> 4) & 3, m, d;
+	issOp src, dst;
+
+	if((w & 0xE000) == 0x2000){				// jumps
+		int off = w & 0x3FF, take = 0;
+		unsigned int sr = reg[2];
+
+		if(off & 0x200)(off -= 0x400);
+		switch((w >> 10) & 7){
+		case 0:	take = !(sr & SR_Z); break;
+		case 1:	take = (sr & SR_Z) != 0; break;
+		case 2:	take = !(sr & SR_C); break;
+		case 3:	take = (sr & SR_C) != 0; break;
+		case 4:	take = (sr & SR_N) != 0; break;
+		case 5:	take = !(sr & SR_N) == !(sr & SR_V); break;
+		case 6:	take = !(sr & SR_N) != !(sr & SR_V); break;
+		default:	take = 1; break;
+		}
+		if(take)(reg[0] = (reg[0] + 2*off) & 0xFFFF);
+		return 2;
+	}
+
+	if((w & 0xFC00) == 0x1000){				// format II
+		int opc = (w >> 7) & 7, r = w & 15;
+
+		if(opc == 6){						// RETI
+			reg[2] = rd16(reg[1]);
+			reg[0] = rd16(reg[1]+2);
+			reg[1] = (reg[1]+4) & 0xFFFF;
+			return 5;
+		}
+		if(opc == 7){
+			return 0;
+		}
+		m = source(as, r, bw && opc != 5, &src);
+		if(src.isConst && opc < 4){
+			return 0;
+		}
+		// the table's modes: register, indexed, @Rn, @Rn+, #N
+		c = cyclesII[m][opc < 4 ? 0 : opc-3];
+		v = src.val;
+		switch(opc){
+		case 0:								// RRC
+			res = (v >> 1) | ((reg[2] & SR_C) ? (bw ? 0x80 : 0x8000) : 0);
+			flags(res, bw, v & 1, 0);
+			break;
+		case 1:								// SWPB
+			res = ((v >> 8) | (v << 8)) & 0xFFFF;
+			break;
+		case 2:								// RRA
+			res = (v >> 1) | (v & (bw ? 0x80 : 0x8000));
+			flags(res, bw, v & 1, 0);
+			break;
+		case 3:								// SXT
+			res = (v & 0x80) ? (v | 0xFF00) : (v & 0xFF);
+			flags(res, 0, res != 0, 0);
+			break;
+		case 4:								// PUSH
+			reg[1] = (reg[1]-2) & 0xFFFF;
+			if(bw)(mem[reg[1]] = v);
+			else(wr16(reg[1], v));
+			return c;
+		default:							// CALL
+			reg[1] = (reg[1]-2) & 0xFFFF;
+			wr16(reg[1], reg[0]);
+			reg[0] = v & 0xFFFE;
+			return c;
+		}
+		if(src.reg >= 0){
+			reg[src.reg] = (bw && opc != 1 && opc != 3) ? res & 0xFF : res & 0xFFFF;
+		}
+		else if(bw && opc != 1 && opc != 3){
+			wr8(src.addr, res);
+		}
+		else{
+			wr16(src.addr, res);
+		}
+		return c;
+	}
+
+	if(w < 0x4000){
+		reg[0] = pc;
+		return 0;
+	}
+
+	// format I
+	m = source(as, (w >> 8) & 15, bw, &src);
+	d = dest((w >> 7) & 1, w & 15, bw, &dst);
+	c = cyclesI[m][d ? 2 : ((w & 15) == 0 ? 1 : 0)];
+	v = src.val;
+	switch(w >> 12){
+	case 0x4:	store(&dst, bw, v); break;										// MOV
+	case 0x5:	store(&dst, bw, addFlags(dst.val, v, 0, bw)); break;			// ADD
+	case 0x6:	store(&dst, bw, addFlags(dst.val, v, reg[2] & SR_C, bw)); break;	// ADDC
+	case 0x7:	store(&dst, bw, addFlags(dst.val, ~v, reg[2] & SR_C, bw)); break;	// SUBC
+	case 0x8:	store(&dst, bw, addFlags(dst.val, ~v, 1, bw)); break;			// SUB
+	case 0x9:	addFlags(dst.val, ~v, 1, bw); break;							// CMP
+	case 0xA:	store(&dst, bw, dadd(dst.val, v, bw)); break;					// DADD
+	case 0xB:															// BIT
+		res = dst.val & v;
+		flags(res, bw, (res & (bw ? 0xFF : 0xFFFF)) != 0, 0);
+		break;
+	case 0xC:	store(&dst, bw, dst.val & ~v); break;							// BIC
+	case 0xD:	store(&dst, bw, dst.val | v); break;							// BIS
+	case 0xE:															// XOR
+		res = dst.val ^ v;
+		flags(res, bw, (res & (bw ? 0xFF : 0xFFFF)) != 0,
+				(dst.val & v & (bw ? 0x80 : 0x8000)) != 0);
+		store(&dst, bw, res);
+		break;
+	default:															// AND
+		res = dst.val & v;
+		flags(res, bw, (res & (bw ? 0xFF : 0xFFFF)) != 0, 0);
+		store(&dst, bw, res);
+		break;
+	}
+	return c;
+}
+
+
+/*
+ * ------------------------------- ELF ---------------------------------
+ */
+unsigned char* elf;
+long elfLeng;
+
+unsigned long get(unsigned long ofs, int n){
+	unsigned long v = 0;
+
+	while(n--)(v = v << 8 | elf[ofs+n]);
+	return v;
+}
+
+/*
+ *  === elfLoad ===
+ *
+ *  Copies the PT_LOAD segments of the 32-bit little endian ELF file to
+ *  their physical addresses, except what falls in the peripherals below
+ *  0x0200 (some linkers map the ELF headers there). Returns 0 if the file
+ *  is not one.
+ *
+ */
+int elfLoad(void){
+	unsigned long ph, off, paddr, filesz, i;
+	int n;
+
+	if(elfLeng < 52 || memcmp(elf, "\177ELF\1\1", 6) || get(18, 2) != 105){		// EM_MSP430
+		return 0;
+	}
+	ph = get(28, 4);
+	for(n=0; n<get(44, 2); n++, ph += get(42, 2)){
+		if(get(ph, 4) != 1){
+			continue;
+		}
+		off = get(ph+4, 4);
+		paddr = get(ph+12, 4);
+		filesz = get(ph+16, 4);
+		for(i=0; i<filesz && paddr+i < 0x10000; i++){
+			if(paddr+i >= 0x0200)(mem[paddr+i] = elf[off+i]);
+		}
+	}
+	return 1;
+}
+
+/*
+ *  === elfSymbol ===
+ *
+ *  Looks name up in the symbol table. Returns 1 and its value and size.
+ *
+ */
+int elfSymbol(const char* name, unsigned long* val, unsigned long* size){
+	unsigned long sh = get(32, 4), s, sym, leng, str, i;
+	int n;
+
+	for(n=0; n<get(48, 2); n++){
+		s = sh + n*get(46, 2);
+		if(get(s+4, 4) != 2){				// SHT_SYMTAB
+			continue;
+		}
+		sym = get(s+16, 4);
+		leng = get(s+20, 4);
+		str = get(sh + get(s+24, 4)*get(46, 2) + 16, 4);
+		for(i=0; i<leng; i+=16){
+			if(!strcmp((char*)&elf[str + get(sym+i, 4)], name)){
+				*val = get(sym+i+4, 4);
+				*size = get(sym+i+8, 4);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+
+int main(int argc, char** argv){
+	unsigned long long maxCycles = 1000000000ULL;
+	unsigned long brk, dump, leng, dummy, i, j;
+	FILE* f;
+	int opt, c;
+
+	while((opt = getopt(argc, argv, "c:t")) != -1){
+		switch(opt){
+		case 'c':
+			maxCycles = strtoull(optarg, 0, 0);
+			break;
+		case 't':
+			trace = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-c max-cycles] [-t] file.elf break-symbol dump-symbol [bytes]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(argc - optind < 3){
+		fprintf(stderr, "usage: %s [-c max-cycles] [-t] file.elf break-symbol dump-symbol [bytes]\n", argv[0]);
+		return 1;
+	}
+
+	if(!(f = fopen(argv[optind], "rb"))){
+		perror(argv[optind]);
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	elfLeng = ftell(f);
+	rewind(f);
+	elf = malloc(elfLeng);
+	if(!elf || fread(elf, 1, elfLeng, f) != elfLeng || !elfLoad()){
+		fprintf(stderr, "%s: not an MSP430 ELF file\n", argv[optind]);
+		return 1;
+	}
+	fclose(f);
+	if(!elfSymbol(argv[optind+1], &brk, &dummy) || !elfSymbol(argv[optind+2], &dump, &leng)){
+		fprintf(stderr, "%s: no symbol %s or %s\n", argv[optind], argv[optind+1], argv[optind+2]);
+		return 1;
+	}
+	if(argc - optind > 3)(leng = strtoul(argv[optind+3], 0, 0));
+
+	reg[0] = rd16(0xFFFE);
+	while(reg[0] != (brk & 0xFFFF)){
+		unsigned int pc = reg[0];
+
+		if((reg[2] & SR_CPUOFF) && !(reg[2] & SR_GIE)){
+			fprintf(stderr, "iss430: CPUOFF with interrupts off at 0x%04x\n", pc);
+			return 1;
+		}
+		c = step();
+		if(c == 0){
+			fprintf(stderr, "iss430: illegal instruction 0x%04x at 0x%04x\n", rd16(pc), pc);
+			return 1;
+		}
+		if(trace)(fprintf(stderr, "%04x %d\n", pc, c));
+		cycles += c;
+		timerRun(c);
+		if(cycles > maxCycles){
+			fprintf(stderr, "iss430: no %s after %llu cycles\n", argv[optind+1], maxCycles);
+			return 1;
+		}
+	}
+	fprintf(stderr, "iss430: %s reached after %llu cycles\n", argv[optind+1], cycles);
+
+	for(i=0; i<leng; i+=16){
+		printf("    %05lx:", (dump+i) & 0xFFFF);
+		for(j=i; j<i+16 && j<leng; j++)(printf(" %02x", mem[(dump+j) & 0xFFFF]));
+		printf("%*s |", (int)(3*(i+16-j)), "");
+		for(j=i; j<i+16 && j<leng; j++){
+			c = mem[(dump+j) & 0xFFFF];
+			putchar(c >= 32 && c < 127 ? c : '.');
+		}
+		printf("|\n");
+	}
+	return 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * burstFunks.c
+ *
+ * Packs HX711 conversions into block frames and records trigger events,
+ * see burstFunks.h.
+ *
+ */
+
+#include "burstFunks.h"
+#include "frameFunks.h"
+#include "serial_handler.h"
+
+#define		ABS(x)		((x) < 0 ? -(x) : (x))
+
+CLK_ASSERT(FRAME_HDR_LENG+7+BURST_BYTES+1 <= uart_max && BURST_BYTES <= BURST_BUF, burst_block_fits);
+
+unsigned int burstDropped = 0;			// blocks that did not fit in the TX ring
+
+burstMem burstBuf;
+unsigned char burstLeng = 0, burstSrc = 0, burstSeq = 0;
+unsigned long burstTime;
+unsigned char burstHxSeq, burstNext;			// stamp of the first conversion, hxSeq expected next
+long int burstPrev[HX_CELLS < 2 ? 2 : HX_CELLS];	// delta: previous conversion, trigger: load of the previous one and when armed
+
+unsigned char trigMode = TRIG_OFF, trigState = TRIG_ST_OFF;
+long int trigLevel = 25600;						// threshold in counts
+unsigned char trigNdx, trigCnt, trigRec = 0;	// next slot, conversions in state
+unsigned char trigOut = 0, trigLeft = 0;		// slot and count still to send
+
+
+void burstReset(void){
+	burstLeng = 0;
+	burstSeq = 0;
+}
+
+
+/*
+ *  === burstPush ===
+ *
+ *  Appends one conversion per cell from source src, stamped hxSeq and
+ *  hxTime. Sends the block when it is full, or first when the source
+ *  changes or conversions were dropped.
+ *
+ */
+void burstPush(long int* sample, unsigned char src){
+	unsigned char c;
+
+	if(burstLeng && (src != burstSrc || hxSeq != burstNext)){
+		burstFlush();
+	}
+	if(burstLeng == 0){
+		burstTime = hxTime;
+		burstHxSeq = hxSeq;
+	}
+	burstSrc = src;
+	burstNext = hxSeq+1;
+
+	for(c=0; c<HX_CELLS; c++){
+		burstBuf.raw[burstLeng++] = sample[c]>>16;
+		burstBuf.raw[burstLeng++] = sample[c]>>8;
+		burstBuf.raw[burstLeng++] = sample[c];
+	}
+
+	if(burstLeng >= BURST_BYTES){
+		burstFlush();
+	}
+}
+
+
+/*
+ *  === burstFlush ===
+ *
+ *  Sends whatever is in burstBuf as a block frame and empties it. The
+ *  sequence number counts every block, sent or dropped.
+ *
+ */
+void burstFlush(void){
+	if(burstLeng == 0){
+		return;
+	}
+	if(!uart_queue(tx_data_str, frameBlock(burstBuf.raw, burstLeng, burstSeq, burstSrc, burstHxSeq, burstTime))){
+		burstDropped++;
+	}
+	burstSeq++;
+	burstLeng = 0;
+}
+
+
+/*
+ *  === trigArm ===
+ *
+ *  Sets the trigger mode (TRIG_OFF ... TRIG_DELTA, plus TRIG_AUTO) and
+ *  starts collecting a new record, discarding the old one.
+ *
+ */
+void trigArm(unsigned char mode){
+	trigMode = mode;
+	trigState = (mode & ~TRIG_AUTO) ? TRIG_ST_FILL : TRIG_ST_OFF;
+	trigNdx = 0;
+	trigCnt = 0;
+	trigLeft = 0;
+	trigRec++;
+}
+
+
+/*
+ *  === trigPush ===
+ *
+ *  Stores one conversion per cell (sign extended, from hxPop) in the
+ *  record and tests the trigger condition on their sum. The condition is
+ *  only tested once the pre-trigger history is full.
+ *
+ */
+void trigPush(long int* sample, unsigned char src){
+	unsigned char c, i;
+	long int load = 0, diff = 0;
+
+	if(trigState == TRIG_ST_OFF || trigState == TRIG_ST_DONE || src != HX_SRC(hxSched[0])){
+		return;
+	}
+
+	i = trigNdx*3*HX_CELLS;
+	for(c=0; c<HX_CELLS; c++){
+		burstBuf.raw[i++] = sample[c]>>16;
+		burstBuf.raw[i++] = sample[c]>>8;
+		burstBuf.raw[i++] = sample[c];
+		load += sample[c];
+	}
+	if(++trigNdx >= TRIG_SETS)(trigNdx = 0);
+	trigCnt++;
+
+	if(trigState == TRIG_ST_FILL){
+		if(trigCnt == 1)(burstPrev[1] = load);
+		if(trigCnt >= TRIG_PRE)(trigState = TRIG_ST_ARMED);
+	}
+	else if(trigState == TRIG_ST_ARMED){
+		switch(trigMode & ~TRIG_AUTO){
+		case TRIG_LEVEL:
+			if(ABS(burstPrev[0]) < trigLevel)(diff = ABS(load));
+			break;
+		case TRIG_SLOPE:
+			diff = ABS(load - burstPrev[0]);
+			break;
+		default:
+			diff = ABS(load - burstPrev[1]);
+			break;
+		}
+		if(diff >= trigLevel){
+			trigState = TRIG_ST_POST;
+			trigCnt = 1;
+			burstTime = hxTime;
+			burstHxSeq = hxSeq;
+		}
+	}
+
+	if(trigState == TRIG_ST_POST && trigCnt >= TRIG_SETS-TRIG_PRE){
+		trigState = TRIG_ST_DONE;
+		if(trigMode & TRIG_AUTO)(trigDump());
+	}
+	burstPrev[0] = load;
+}
+
+
+/*
+ *  === trigDump ===
+ *
+ *  Starts sending the completed record, oldest conversion first. Returns
+ *  the number of conversions in it, or 0 if there is no record yet.
+ *
+ */
+int trigDump(void){
+	if(trigState != TRIG_ST_DONE){
+		return 0;
+	}
+	trigOut = trigNdx;				// the oldest slot is overwritten next
+	trigLeft = TRIG_SETS;
+	return TRIG_SETS;
+}
+
+
+/*
+ *  === trigSend ===
+ *
+ *  Called from the mainloop. Queues event frames of TRIG_CHUNK conversions
+ *  while the TX ring has room, the rest once it has drained (EV_TX), so a
+ *  dump completes after sampling has stopped.
+ *
+ */
+void trigSend(void){
+	unsigned char n, leng;
+
+	while(trigLeft){
+		n = (trigLeft < TRIG_CHUNK) ? trigLeft : TRIG_CHUNK;
+		if(n > TRIG_SETS-trigOut)(n = TRIG_SETS-trigOut);	// stop at the end of burstBuf
+		leng = 3*HX_CELLS*n;
+		if(!uart_tx_room(FRAME_HDR_LENG+4+FRAME_STAMP_LENG+leng)){
+			return;
+		}
+		uart_queue(tx_data_str, frameEvent(&burstBuf.raw[3*HX_CELLS*trigOut], leng,
+				trigRec, TRIG_SETS-trigLeft-TRIG_PRE, HX_SRC(hxSched[0]), burstHxSeq, burstTime));
+		trigLeft -= n;
+		trigOut += n;
+		if(trigOut >= TRIG_SETS)(trigOut = 0);
+	}
+}
@@ -0,0 +1,89 @@
+/*
+ * burstFunks.h - Burst and trigger capture
+ *
+ * In burst mode (B002) every HX711 conversion is kept, unfiltered, and
+ * packed into burstBuf as 24-bit values (HX_CELLS per conversion). A full
+ * buffer is sent as one block frame (see frameFunks.h) and the next
+ * conversions go into the emptied buffer while the block drains from the
+ * UART TX ring, so nothing is lost as long as the link carries the
+ * average rate (3*HX_CELLS bytes per conversion plus 11 per block). A
+ * block fits in tx_data_str, and with a sample frame in the TX ring.
+ *
+ * A block only holds consecutive conversions (hxSeq) of one source
+ * (HX_SRC), so a schedule of several gains or a dropped conversion sends
+ * short blocks. The block carries the stamp of its first conversion.
+ *
+ * The trigger engine records the conversions around a load event. Once
+ * armed it keeps the last TRIG_PRE conversions in burstBuf, and fires
+ * when the load (sum of all cells) meets the condition:
+ *
+ * 		TRIG_LEVEL	|load| rises through the threshold
+ * 		TRIG_SLOPE	|load - previous conversion| >= threshold
+ * 		TRIG_DELTA	|load - load when armed| >= threshold
+ *
+ * It then records TRIG_SETS-TRIG_PRE more conversions, the first one
+ * being the conversion that fired, whose stamp the event frames carry.
+ * The record spans TRIG_MS at HX_SPS whatever the number of cells, so
+ * burstBuf is sized for it (30 bytes with one cell, 120 with four); with
+ * several gains scheduled only the first source is recorded and the
+ * record covers that many times longer. It is kept until the trigger is
+ * armed again and sent as event frames (frameFunks.h) by trigDump(), or
+ * right away with TRIG_AUTO. Only conversions of the first scheduled
+ * source are used. Burst mode, delta mode (deltaFunks.h) and the trigger
+ * share burstBuf, so only one of them can be active. It also holds the
+ * history of the load filter (filtFunks.h) when its order is above 0, so
+ * the last of B002/B003, E### and O### wins (see main.c).
+ *
+ */
+
+#ifndef BURSTFUNKS_H_
+#define BURSTFUNKS_H_
+
+#include "loadCellFunks.h"
+#include "filtFunks.h"
+
+#define		BURST_BUF		(3*HX_CELLS*TRIG_SETS)	// the trigger record, blocks and delta frames are shorter
+#define		BURST_SETS		(HX_CELLS == 1 ? 7 : 12/HX_CELLS - 1)	// conversions per block, 21 bytes with one cell
+#define		BURST_BYTES		(3*HX_CELLS*BURST_SETS)
+
+#define		TRIG_MS			125						// record length
+#define		TRIG_SETS		(TRIG_MS*HX_SPS/1000)	// conversions per record, 10
+#define		TRIG_PRE		(TRIG_SETS/2)				// of which before the trigger
+#define		TRIG_CHUNK		(12/(3*HX_CELLS))			// conversions per event frame
+
+#define		TRIG_OFF		0			// trigMode
+#define		TRIG_LEVEL		1
+#define		TRIG_SLOPE		2
+#define		TRIG_DELTA		3
+#define		TRIG_AUTO		4			// or'ed in: send the record when complete
+
+#define		TRIG_ST_OFF		0			// trigState
+#define		TRIG_ST_FILL	1			// collecting pre-trigger history
+#define		TRIG_ST_ARMED	2
+#define		TRIG_ST_POST	3			// fired, collecting the rest
+#define		TRIG_ST_DONE	4			// record complete
+
+
+typedef union {
+	unsigned char raw[BURST_BUF];				// block, delta frame or trigger record
+	long int filt[HX_CELLS][FILT_MAX_ORDER+1];	// or the filter history
+} burstMem;
+
+extern burstMem burstBuf;
+extern unsigned long burstTime;					// stamp of the block, delta frame or trigger
+extern unsigned char burstLeng, burstSrc, burstSeq, burstHxSeq, burstNext;
+extern long int burstPrev[HX_CELLS < 2 ? 2 : HX_CELLS];	// delta mode or the trigger
+extern unsigned int burstDropped;				// block, event or delta frames
+extern unsigned char trigMode, trigState;
+extern long int trigLevel;
+
+void burstReset(void);
+void burstPush(long int*, unsigned char);
+void burstFlush(void);
+void trigArm(unsigned char);
+void trigPush(long int*, unsigned char);
+int trigDump(void);
+void trigSend(void);
+
+
+#endif /* BURSTFUNKS_H_ */
@@ -0,0 +1,222 @@
+/*
+ * calFunks.c
+ *
+ * Calibration records in information flash, see calFunks.h. Only called
+ * from the mainloop.
+ *
+ */
+
+#include "calFunks.h"
+#include "flashFunks.h"
+#include "frameFunks.h"
+
+#define		CAL_KEY			0x5A		// an erased segment never checks out
+#define		CAL_G_Q11		20084		// 9.80665 * 2^11
+#define		CAL_CHECKED(r)	((unsigned char*)&(r)->check - (unsigned char*)(r))	// bytes before check
+
+const calRecord* calRec = 0;				// calibration in effect, 0 if none
+
+static int calValid(const calRecord*);
+static int calWrite(long int*, unsigned char, int, unsigned char, unsigned char, unsigned char);
+
+
+/*
+ *  === calInit ===
+ *
+ *  Selects the newer valid record of segments D and C, if any.
+ *
+ */
+void calInit(void){
+	const calRecord* d = (const calRecord*)HAL_INFO_D;
+	const calRecord* c = (const calRecord*)HAL_INFO_C;
+
+	calRec = 0;
+	if(calValid(d))(calRec = d);
+	if(calValid(c) && (!calRec || (signed char)(c->seq - d->seq) > 0))(calRec = c);
+}
+
+
+/*
+ *  === calTare ===
+ *
+ *  Takes the loads (one per cell, as filtered for the frames) of source
+ *  src as the zero. The spans and unit are kept if src is the source of the
+ *  current calibration, cleared otherwise. Returns 1 if the record could
+ *  not be written (the previous one stays in effect).
+ *
+ */
+int calTare(long int* load, unsigned char src){
+	if(calRec && calRec->src == src){
+		return calWrite(load, src, 0, 0, CAL_KEEP, calRec->unit);
+	}
+	return calWrite(load, src, 0, 0, CAL_ALL, CAL_RAW);
+}
+
+
+/*
+ *  === calSpan ===
+ *
+ *  Sets the span from the loads of source src with grams on the rig: for
+ *  one cell, or with CAL_ALL one span for the sum of all cells. Returns 1
+ *  if there is no tare for src, a value is out of range, the load hardly
+ *  moved from the tare, or the record could not be written.
+ *
+ */
+int calSpan(long int* load, unsigned char src, int grams, unsigned char cell){
+	long int delta = 0;
+	unsigned long rem;
+	unsigned int m;
+	unsigned char c, s = 0, neg;
+
+	if(!calRec || calRec->src != src || grams < 1 || grams > CAL_MASS_MAX ||
+			(cell >= HX_CELLS && cell != CAL_ALL)){
+		return 1;
+	}
+	for(c=0; c<HX_CELLS; c++){
+		if(cell == CAL_ALL || cell == c)(delta += load[c] - calRec->ofs[c]);
+	}
+	neg = (delta < 0);
+	if(neg)(delta = -delta);
+	if(delta == 0){
+		return 1;
+	}
+
+	// gain * 2^-s = grams / delta, long division until gain has 15 bits
+	m = grams / delta;					// < 0x4000 as grams is
+	rem = grams % delta;
+	while(m < 0x4000){
+		rem <<= 1;
+		m <<= 1;
+		if(rem >= (unsigned long)delta){
+			rem -= delta;
+			m |= 1;
+		}
+		s++;
+	}
+	if(s < CAL_SHIFT_MIN){
+		return 1;
+	}
+	return calWrite(0, src, neg ? -(int)m : (int)m, s, cell, calRec->unit);
+}
+
+
+/*
+ *  === calUnits ===
+ *
+ *  Sets the unit of the frames. Returns 1 if it is unknown, or is not
+ *  CAL_RAW and a cell has no span yet, or the record could not be written.
+ *
+ */
+int calUnits(int unit){
+	unsigned char c;
+
+	if(unit < CAL_RAW || unit > CAL_MN || (unit != CAL_RAW && !calRec)){
+		return 1;
+	}
+	if(!calRec || calRec->unit == unit){
+		return 0;
+	}
+	for(c=0; c<HX_CELLS; c++){
+		if(unit != CAL_RAW && calRec->gain[c] == 0){
+			return 1;
+		}
+	}
+	return calWrite(0, calRec->src, 0, 0, CAL_KEEP, unit);
+}
+
+
+/*
+ *  === calUnit ===
+ *
+ *  Returns the unit the loads of source src are sent in.
+ *
+ */
+unsigned char calUnit(unsigned char src){
+	return (calRec && calRec->src == src) ? calRec->unit : CAL_RAW;
+}
+
+
+/*
+ *  === calApply ===
+ *
+ *  Converts the loads of the calibrated source (sign extended counts, one
+ *  per cell) to the unit in effect, clamped to 24 bits. load and out may be
+ *  the same.
+ *
+ */
+void calApply(long int* load, long int* out){
+	long int d;
+	int m;
+	unsigned char c, sh;
+
+	for(c=0; c<HX_CELLS; c++){
+		d = load[c] - calRec->ofs[c];
+		if(d > 0x007FFFFFL)(d = 0x007FFFFFL);
+		if(d < -0x007FFFFFL)(d = -0x007FFFFFL);
+		m = calRec->gain[c];
+		sh = calRec->shift[c];
+		if(calRec->unit == CAL_MN){
+			m = ((long int)m * CAL_G_Q11) >> 15;		// still 15 bits, 16 times smaller
+			sh -= 4;
+		}
+
+		// d * m >> 8 in two halves, each product < 2^31
+		d = (((d >> 8) * m) + (((d & 0xFF) * m) >> 8)) >> (sh - 8);
+		if(d > 0x007FFFFFL)(d = 0x007FFFFFL);
+		if(d < -0x007FFFFFL)(d = -0x007FFFFFL);
+		out[c] = d;
+	}
+}
+
+
+/*
+ *  === calValid ===
+ *
+ *  Returns 1 if rec holds a record written by calWrite.
+ *
+ */
+static int calValid(const calRecord* rec){
+	return (crc8((unsigned char*)rec, CAL_CHECKED(rec)) ^ CAL_KEY) == rec->check;
+}
+
+
+/*
+ *  === calWrite ===
+ *
+ *  Writes a record into the segment not in use: the tare from load (the
+ *  current one if 0), the span gain/shift for the given cell or CAL_ALL
+ *  (the current ones for the others or CAL_KEEP), and the unit. Makes it
+ *  the current record if every byte reads back.
+ *
+ */
+static int calWrite(long int* load, unsigned char src, int gain, unsigned char shift,
+		unsigned char cell, unsigned char unit){
+	const calRecord* old = calRec;
+	calRecord* rec = (calRecord*)((old == (const calRecord*)HAL_INFO_D) ? HAL_INFO_C : HAL_INFO_D);
+	unsigned char c, b, error = 0;
+
+	flashErase((unsigned char*)rec);
+	for(c=0; c<HX_CELLS; c++){
+		error |= flashWrite((unsigned char*)&rec->ofs[c], load ? &load[c] : &old->ofs[c], sizeof(long int));
+		if(cell == CAL_ALL || cell == c){
+			error |= flashWrite((unsigned char*)&rec->gain[c], &gain, sizeof(int));
+			error |= flashWrite(&rec->shift[c], &shift, 1);
+		}
+		else{
+			error |= flashWrite((unsigned char*)&rec->gain[c], &old->gain[c], sizeof(int));
+			error |= flashWrite(&rec->shift[c], &old->shift[c], 1);
+		}
+	}
+	error |= flashWrite(&rec->src, &src, 1);
+	error |= flashWrite(&rec->unit, &unit, 1);
+	b = old ? old->seq + 1 : 0;
+	error |= flashWrite(&rec->seq, &b, 1);
+	b = crc8((unsigned char*)rec, CAL_CHECKED(rec)) ^ CAL_KEY;
+	error |= flashWrite(&rec->check, &b, 1);
+
+	if(error){
+		return 1;
+	}
+	calRec = rec;
+	return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * calFunks.h - Tare, span and engineering units
+ *
+ * Converts the loads of the sample frames from raw HX711 counts to grams
+ * or millinewtons, per cell:
+ *
+ * 		grams = (counts - ofs) * gain * 2^-shift
+ * 		mN = grams * 9.80665
+ *
+ * ofs is the tare and gain/shift the span. gain is normalised to 15 bits
+ * (0x4000-0x7FFF, negative if the cell reads negative under load), which
+ * keeps the product within a long without a hardware multiplier. A span
+ * of more than 8 grams per count (shift < CAL_SHIFT_MIN) is rejected.
+ *
+ * The calibration is one calRecord in information flash (flashFunks.h),
+ * read in place. Each change writes a complete new record into the other
+ * of segments D and C, so the previous one survives a reset during the
+ * write. calInit() picks the newer valid record (check, seq) at reset,
+ * before 'G'.
+ *
+ * It belongs to the source it was tared on (src). Frames of other sources
+ * stay in counts, and so do the raw conversions of burst, delta and event
+ * frames, the trigger and the force controller.
+ *
+ */
+
+#ifndef CALFUNKS_H_
+#define CALFUNKS_H_
+
+#include "loadCellFunks.h"
+
+#define		CAL_RAW			0			// unit, counts
+#define		CAL_GRAMS		1
+#define		CAL_MN			2			// millinewtons
+#define		CAL_MASS_MAX	9999		// span mass, grams
+#define		CAL_SHIFT_MIN	12			// at most 8 grams per count, leaves room for mN
+#define		CAL_ALL			0xFF		// calSpan cell, one span for the sum of all cells
+#define		CAL_KEEP		0xFE		// spans of the previous record
+
+
+typedef struct {
+	long int ofs[HX_CELLS];				// tare, counts
+	int gain[HX_CELLS];					// span, 0 if none
+	unsigned char shift[HX_CELLS];
+	unsigned char src;					// HX_SRC() of the tare
+	unsigned char unit;					// CAL_RAW, CAL_GRAMS or CAL_MN
+	unsigned char seq;					// +1 per record written, wraps
+	unsigned char check;				// crc8 of the bytes before ^ CAL_KEY, last member
+} calRecord;
+
+extern const calRecord* calRec;
+
+void calInit(void);
+int calTare(long int*, unsigned char);
+int calSpan(long int*, unsigned char, int, unsigned char);
+int calUnits(int);
+unsigned char calUnit(unsigned char);
+void calApply(long int*, long int*);
+
+
+#endif /* CALFUNKS_H_ */
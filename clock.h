@@ -0,0 +1,76 @@
+/*
+ * clock.h - Clock configuration
+ *
+ * MCLK_HZ selects the calibrated DCO frequency, 1, 8 or 16 MHz (build with
+ * e.g. -DMCLK_HZ=16000000). Every clock dependent constant is derived from
+ * it here:
+ *
+ * 		SMCLK_HZ		MCLK / SMCLK_DIV, clocks the timers and the UART
+ * 		TA_HZ			timer tick, SMCLK / TA_DIV. Kept at 250 kHz for every
+ * 						MCLK, so sample periods, PWM pulses, the DHT11 timing
+ * 						and the T command do not change with the clock.
+ * 		CYCLES_US(us)	MCLK cycles for __delay_cycles
+ * 		TA_US(us)		timer ticks
+ * 		UART_BR(bps)	UCBRx and UCBRSx for bps, UCOS16 = 0
+ * 		UART_BRS(bps)
+ * 		FLASH_DIV		MCLK divider for the flash timing generator (FCTL2),
+ * 						FLASH_HZ must be within 257-476 kHz
+ *
+ * 12 MHz is not supported, no power of two divider gives a 250 kHz tick.
+ *
+ */
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#ifndef MCLK_HZ
+#define		MCLK_HZ			1000000
+#endif
+
+#if MCLK_HZ == 1000000
+#define		CLK_CALBC1		CALBC1_1MHZ
+#define		CLK_CALDCO		CALDCO_1MHZ
+#define		SMCLK_DIVS		DIVS_0
+#define		SMCLK_DIV		1
+#define		TA_ID			ID_2
+#define		TA_DIV			4
+#elif MCLK_HZ == 8000000
+#define		CLK_CALBC1		CALBC1_8MHZ
+#define		CLK_CALDCO		CALDCO_8MHZ
+#define		SMCLK_DIVS		DIVS_2
+#define		SMCLK_DIV		4
+#define		TA_ID			ID_3
+#define		TA_DIV			8
+#elif MCLK_HZ == 16000000
+#define		CLK_CALBC1		CALBC1_16MHZ
+#define		CLK_CALDCO		CALDCO_16MHZ
+#define		SMCLK_DIVS		DIVS_3
+#define		SMCLK_DIV		8
+#define		TA_ID			ID_3
+#define		TA_DIV			8
+#else
+#error "MCLK_HZ must be 1000000, 8000000 or 16000000"
+#endif
+
+#define		SMCLK_HZ		(MCLK_HZ / SMCLK_DIV)
+#define		TA_HZ			(SMCLK_HZ / TA_DIV)
+
+#define		CYCLES_US(us)	((unsigned long)(MCLK_HZ / 1000000) * (us))
+#define		TA_US(us)		((unsigned long)(us) * (TA_HZ / 1000) / 1000)
+
+#define		UART_N8(bps)	((8UL*SMCLK_HZ + (bps)/2) / (bps))	// 8 * SMCLK/bps, rounded
+#define		UART_BR(bps)	(UART_N8(bps) >> 3)
+#define		UART_BRS(bps)	((UART_N8(bps) & 7) << 1)			// UCBRSx field
+
+#define		FLASH_DIV		((MCLK_HZ + 399999) / 400000)		// at most 400 kHz
+#define		FLASH_HZ		(MCLK_HZ / FLASH_DIV)
+
+
+// compile time check, an array of negative size if cond is false
+#define		CLK_ASSERT(cond, name)	typedef char name[(cond) ? 1 : -1]
+
+CLK_ASSERT(TA_HZ == 250000, clk_ta_tick_is_250khz);
+CLK_ASSERT(FLASH_HZ >= 257000 && FLASH_HZ <= 476000 && FLASH_DIV <= 64, clk_flash_timing);
+
+
+#endif /* CLOCK_H_ */
@@ -0,0 +1,103 @@
+/*
+ * ctrlFunks.c
+ *
+ * Fixed-point PI force controller, see ctrlFunks.h. Only called from the
+ * mainloop, so nothing here needs interrupts held off.
+ *
+ */
+
+#include "ctrlFunks.h"
+
+int ctrlSet = 0, ctrlKp = 40, ctrlKi = 0;
+unsigned char ctrlRev = 50, ctrlFor = 50, ctrlILim = 50, ctrlOn = 0;
+long int ctrlInt = 0;						// I, 2^-CTRL_SHIFT percent
+
+
+/*
+ *  === ctrlStart ===
+ *
+ *  Sets the setpoint (steps of 256 counts) and closes the loop. The
+ *  integral starts from zero unless the loop was already closed, so a new
+ *  setpoint does not bump the output. Returns 1 if the setpoint is out of
+ *  range (nothing is changed).
+ *
+ */
+int ctrlStart(int set){
+	if(set < 0 || set > CTRL_SET_MAX){
+		return 1;
+	}
+	if(!ctrlOn)(ctrlInt = 0);
+	ctrlSet = set;
+	ctrlOn = 1;
+	return 0;
+}
+
+void ctrlStop(void){
+	ctrlOn = 0;
+}
+
+
+/*
+ *  === ctrlGains / ctrlLimits ===
+ *
+ *  Set Kp and Ki (0-CTRL_GAIN_MAX), and the reverse, forward and integral
+ *  limits (percent). Return 1 if a value is out of range (nothing is
+ *  changed). A lower integral limit applies from the next conversion.
+ *
+ */
+int ctrlGains(int kp, int ki){
+	if(kp < 0 || kp > CTRL_GAIN_MAX || ki < 0 || ki > CTRL_GAIN_MAX){
+		return 1;
+	}
+	ctrlKp = kp;
+	ctrlKi = ki;
+	return 0;
+}
+
+int ctrlLimits(int rev, int fwd, int ilim){
+	if(rev < 0 || rev > 100 || fwd < 0 || fwd > 100 || ilim < 0 || ilim > 100){
+		return 1;
+	}
+	ctrlRev = rev;
+	ctrlFor = fwd;
+	ctrlILim = ilim;
+	return 0;
+}
+
+
+/*
+ *  === ctrlStep ===
+ *
+ *  Runs the controller on one sign extended conversion per cell (as
+ *  returned by hxPop) and returns the output in 1/256 percent, positive
+ *  forward, e.g. 12800 = 50% forward.
+ *
+ */
+int ctrlStep(long int* sample){
+	long int e = (long int)ctrlSet << 8, x, p, u, hi, lo;
+	unsigned char c;
+
+	for(c=0; c<HX_CELLS; c++){
+		e -= sample[c];
+	}
+	if(e > CTRL_E_MAX)(e = CTRL_E_MAX);
+	if(e < -CTRL_E_MAX)(e = -CTRL_E_MAX);
+
+	hi = CTRL_PCT(ctrlFor);
+	lo = -CTRL_PCT(ctrlRev);
+	p = ctrlKp * e;
+	u = p + ctrlInt;
+
+	// anti-windup: hold I while the output is pinned and e would push it further
+	if(!(u >= hi && e > 0) && !(u <= lo && e < 0)){
+		ctrlInt += (ctrlKi * e) >> CTRL_KI_SHIFT;
+		x = CTRL_PCT(ctrlILim);
+		if(ctrlInt > x)(ctrlInt = x);
+		if(ctrlInt < -x)(ctrlInt = -x);
+		u = p + ctrlInt;
+	}
+
+	if(u > hi)(u = hi);
+	if(u < lo)(u = lo);
+	return u >> (CTRL_SHIFT-8);
+}
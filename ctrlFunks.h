@@ -0,0 +1,48 @@
+/*
+ * ctrlFunks.h - Closed loop force control
+ *
+ * Holds the load at a setpoint by driving the PWM output itself, so the
+ * loop no longer waits on the host and the UART. ctrlStep() runs on every
+ * HX711 conversion of the first scheduled source (the same conversions
+ * the trigger sees, unfiltered) and returns the new output. The load is
+ * the sum of all cells. A fixed-point PI controller:
+ *
+ * 		e = setpoint - load							counts
+ * 		u = Kp*e + I,	I = I + Ki*e/2^CTRL_KI_SHIFT	2^-CTRL_SHIFT percent
+ *
+ * Kp = 100 asks for 100% output at 65536 counts of error. Ki = 256 adds
+ * that much per conversion, Ki = 1 takes 256 conversions, so the integral
+ * gain scales with the conversion rate. At 10 conversions/s and Kp = 40
+ * useful values of Ki are around 001-020. Errors beyond CTRL_E_MAX are
+ * clamped, which keeps every product within a long.
+ *
+ * Anti-windup: I is clamped to ctrlILim percent, and it only integrates
+ * while the output is not already at a limit in the direction of the error.
+ * u is clamped to ctrlRev percent reverse and ctrlFor percent forward.
+ *
+ */
+
+#ifndef CTRLFUNKS_H_
+#define CTRLFUNKS_H_
+
+#include "loadCellFunks.h"
+
+#define		CTRL_SHIFT		16
+#define		CTRL_KI_SHIFT	8				// Ki is in 1/256 of Kp's scale
+#define		CTRL_PCT(p)		((long int)(p) << CTRL_SHIFT)
+#define		CTRL_E_MAX		0x000FFFFFL		// 2^20 - 1 counts, 999 * 2^20 < 2^31
+#define		CTRL_GAIN_MAX	999
+#define		CTRL_SET_MAX	999				// setpoint in steps of 256 counts
+
+
+extern int ctrlSet, ctrlKp, ctrlKi;
+extern unsigned char ctrlRev, ctrlFor, ctrlILim, ctrlOn;
+
+int ctrlStart(int);
+void ctrlStop(void);
+int ctrlGains(int, int);
+int ctrlLimits(int, int, int);
+int ctrlStep(long int*);
+
+
+#endif /* CTRLFUNKS_H_ */
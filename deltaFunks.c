@@ -0,0 +1,119 @@
+/*
+ * deltaFunks.c
+ *
+ * Zig-zag varint encoder for the delta mode, see deltaFunks.h. Shares
+ * burstBuf and its state with burst mode and the trigger.
+ *
+ */
+
+#include "deltaFunks.h"
+#include "burstFunks.h"
+#include "frameFunks.h"
+#include "serial_handler.h"
+
+#define		ZIGZAG(d)	((d) < 0 ? ((unsigned long)~(d) << 1) | 1 : (unsigned long)(d) << 1)
+
+CLK_ASSERT(FRAME_HDR_LENG+8+DELTA_BYTES+1 <= uart_max && DELTA_BYTES <= BURST_BUF, delta_frame_fits);
+
+unsigned char deltaSets = 0;						// length, source and sequence are burst mode's
+unsigned char deltaKey = 0;						// frames until the next keyframe
+
+
+void deltaReset(void){
+	burstReset();
+	deltaSets = 0;
+	deltaKey = 0;
+}
+
+
+/*
+ *  === deltaPush ===
+ *
+ *  Appends one conversion per cell from source src, as absolute values if
+ *  it starts a keyframe. Sends the frame first when the conversion does
+ *  not fit, the source changes or conversions were dropped, so every frame
+ *  fills DELTA_BYTES. The deltas are taken on the sign extended values
+ *  hxPop returns, so a load crossing zero costs a byte or two, not four.
+ *
+ */
+void deltaPush(long int* sample, unsigned char src){
+	unsigned char c, n;
+	unsigned long z;
+	long int d, x;
+
+	if(deltaSets && src != burstSrc){
+		deltaFlush();
+		deltaKey = 0;
+	}
+	else if(deltaSets && hxSeq != burstNext){
+		deltaFlush();					// the deltas still follow on
+	}
+	else if(deltaSets){
+		n = 0;
+		for(c=0; c<HX_CELLS; c++){
+			d = sample[c] - burstPrev[c];
+			z = ZIGZAG(d);
+			do{
+				n++;
+				z >>= 7;
+			}while(z);
+		}
+		if(burstLeng + n > DELTA_BYTES)(deltaFlush());
+	}
+	if(deltaSets == 0){
+		burstTime = hxTime;
+		burstHxSeq = hxSeq;
+	}
+	burstSrc = src;
+	burstNext = hxSeq+1;
+
+	for(c=0; c<HX_CELLS; c++){
+		x = sample[c];
+		if(deltaSets == 0 && deltaKey == 0){
+			burstBuf.raw[burstLeng++] = x>>16;
+			burstBuf.raw[burstLeng++] = x>>8;
+			burstBuf.raw[burstLeng++] = x;
+		}
+		else{
+			d = x - burstPrev[c];
+			z = ZIGZAG(d);
+			while(z > 0x7F){
+				burstBuf.raw[burstLeng++] = z | 0x80;
+				z >>= 7;
+			}
+			burstBuf.raw[burstLeng++] = z;
+		}
+		burstPrev[c] = x;
+	}
+	deltaSets++;
+}
+
+
+/*
+ *  === deltaFlush ===
+ *
+ *  Sends the collected conversions as a delta frame. A frame that does not
+ *  fit in the TX ring is dropped, and the next one made a keyframe.
+ *
+ */
+void deltaFlush(void){
+	unsigned char info = FRAME_F_SRC(burstSrc) | HX_CELLS;
+
+	if(deltaSets == 0){
+		return;
+	}
+	if(deltaKey == 0){
+		info |= DELTA_F_KEY;
+		deltaKey = DELTA_KEY;
+	}
+	if(uart_queue(tx_data_str, frameDelta(burstBuf.raw, burstLeng, burstSeq, info, deltaSets, burstHxSeq, burstTime))){
+		deltaKey--;
+	}
+	else{
+		burstDropped++;
+		deltaKey = 0;
+	}
+	burstSeq++;
+	burstLeng = 0;
+	deltaSets = 0;
+}
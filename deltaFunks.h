@@ -0,0 +1,44 @@
+/*
+ * deltaFunks.h - Delta compressed load stream
+ *
+ * In delta mode (B003) every HX711 conversion is sent, like in burst mode,
+ * but as the difference to the previous conversion of the same cell. The
+ * differences are zig-zag encoded (0, -1, 1, -2 ... -> 0, 1, 2, 3 ...) and
+ * written as varints, 7 bits per byte, least significant first, bit 7 set
+ * on all but the last byte. A change of a few counts takes one byte instead
+ * of three (binary) or nine (ASCII).
+ *
+ * Conversions are collected in burstBuf and sent as delta frames (see
+ * frameFunks.h). Every DELTA_KEY-th frame is a keyframe: its first
+ * conversion is sent as absolute 24-bit values, the deltas of the frame
+ * continue from there. A computer that misses a frame (sequence gap, bad
+ * crc) waits for the next keyframe. A frame that does not fit in the TX
+ * ring, a change of source and "B003" force a keyframe. Like a block, a
+ * frame only holds consecutive conversions and carries the stamp of the
+ * first one, and is sent once the next conversion would not fit in its
+ * DELTA_BYTES (20 bytes with one cell, as much as tx_data_str holds, 23
+ * with four, the rest of the TX ring is kept for a sample frame). With
+ * several gains scheduled (C command) the source changes on every
+ * conversion, so use burst mode there.
+ *
+ * ../host/lcsFrame.c decodes the frames, ../host/lcsBench reports the
+ * compression of a capture.
+ *
+ */
+
+#ifndef DELTAFUNKS_H_
+#define DELTAFUNKS_H_
+
+#include "loadCellFunks.h"
+
+#define		DELTA_BYTES		(HX_CELLS == 1 ? 20 : 35-3*HX_CELLS)	// keyframe and varints per frame, see above
+#define		DELTA_KEY		8			// frames per keyframe
+#define		DELTA_F_KEY		0x80		// in the src/cells byte
+
+
+void deltaReset(void);
+void deltaPush(long int*, unsigned char);
+void deltaFlush(void);
+
+
+#endif /* DELTAFUNKS_H_ */
@@ -0,0 +1,23 @@
+/*
+ * events.h - Mainloop events
+ *
+ * Interrupts hand work to the mainloop by setting bits in 'events'. Every
+ * interrupt vector leaves LPM0 on exit while an event is pending, and the
+ * mainloop sleeps in LPM0 whenever none is.
+ *
+ */
+
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+#define		EV_HX		0x01		// conversion(s) waiting in the HX711 sample queue
+#define		EV_TH		0x02		// temp/humidity sensor needs the mainloop (state 0 or 4)
+#define		EV_SAMPLE	0x04		// sample period elapsed, send a frame
+#define		EV_CMD		0x08		// command received
+#define		EV_TX		0x10		// TX ring drained for a sender waiting on uart_tx_room()
+
+
+extern volatile unsigned char events;
+
+
+#endif /* EVENTS_H_ */
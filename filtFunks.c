@@ -0,0 +1,110 @@
+/*
+ * filtFunks.c
+ *
+ * Fixed-point decimation filter for the load cell channel, see
+ * filtFunks.h for the filter types.
+ *
+ */
+
+#include "filtFunks.h"
+#include "burstFunks.h"
+
+unsigned char filtRate = 1, filtOrder = 0;		// 1/0 passes conversions straight through
+
+long int filtAcc[HX_CELLS];				// sum of the group so far
+unsigned char filtNdx = 0, filtCnt = 0;		// slot in burstBuf.filt, the last filtOrder+1 group averages
+
+// rows 0 to FILT_MAX_ORDER of Pascal's triangle, row n starts at n*(n+1)/2
+const unsigned char filtPascal[] = {
+		1,
+		1, 1,
+		1, 2, 1,
+		1, 3, 3, 1,
+		1, 4, 6, 4, 1,
+		1, 5, 10, 10, 5, 1,
+		1, 6, 15, 20, 15, 6, 1,
+		1, 7, 21, 35, 35, 21, 7, 1
+};
+const unsigned char* filtCoef = filtPascal;		// row filtOrder
+
+
+/*
+ *  === filtConfig ===
+ *
+ *  Sets the decimation rate and filter order and clears the filter state.
+ *  Returns 1 if either value is out of range (nothing is changed).
+ *
+ */
+int filtConfig(int rate, int order){
+	unsigned char i, c;
+
+	if(rate < 1 || rate > FILT_MAX_RATE || order < 0 || order > FILT_MAX_ORDER){
+		return 1;
+	}
+
+	filtRate = rate;
+	filtOrder = order;
+
+	filtCoef = &filtPascal[order*(order+1)/2];		// binomial coefficients
+
+	for(c=0; c<HX_CELLS; c++){
+		filtAcc[c] = 0;
+		for(i=0; order && i<=order; i++){		// burstBuf is not ours with order 0
+			burstBuf.filt[c][i] = 0;
+		}
+	}
+	filtNdx = 0;
+	filtCnt = 0;
+
+	return 0;
+}
+
+
+/*
+ *  === filtPush ===
+ *
+ *  Feeds one sign extended conversion per cell (as returned by hxPop) into
+ *  the filter. Returns 1 and writes the filtered values, sign extended as
+ *  well, to out[] once every filtRate calls.
+ *
+ */
+int filtPush(long int* in, long int* out){
+	long int sum;
+	unsigned char i, c, ndx;
+
+	for(c=0; c<HX_CELLS; c++){
+		filtAcc[c] += in[c];
+	}
+
+	if(++filtCnt < filtRate){
+		return 0;
+	}
+	filtCnt = 0;
+
+	for(c=0; c<HX_CELLS; c++){
+		sum = filtAcc[c];			// group average, rounded to nearest
+		filtAcc[c] = 0;
+		if(filtRate > 1){
+			sum += (sum < 0) ? -(filtRate/2) : filtRate/2;
+			sum /= filtRate;
+		}
+
+		if(filtOrder != 0){
+			burstBuf.filt[c][filtNdx] = sum;
+			sum = 0;
+			ndx = (filtNdx == filtOrder) ? 0 : filtNdx+1;		// oldest average
+			for(i=0; i<=filtOrder; i++){
+				sum += burstBuf.filt[c][ndx]*filtCoef[i];
+				ndx = (ndx == filtOrder) ? 0 : ndx+1;
+			}
+			sum += 1L<<(filtOrder-1);		// round
+			sum >>= filtOrder;
+		}
+
+		out[c] = sum;
+	}
+	if(filtOrder != 0){
+		filtNdx = (filtNdx == filtOrder) ? 0 : filtNdx+1;
+	}
+	return 1;
+}
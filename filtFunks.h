@@ -0,0 +1,46 @@
+/*
+ * filtFunks.h - Load channel decimation filter
+ *
+ * Every HX711 conversion is pushed through the filter, which emits one
+ * output per filtRate inputs. The conversions are summed in groups of
+ * filtRate (integrate and dump, a single stage CIC) and each group
+ * average, rounded to nearest, then goes through
+ *
+ * 		order 0		nothing, the output is the group average
+ * 		order n		binomial FIR over the last n+1 group averages,
+ * 					coefficients are row n of Pascal's triangle so the
+ * 					gain is 2^n (a shift)
+ *
+ * So every conversion counts once and the FIR taps are filtRate
+ * conversions apart, it spans (n+1)*filtRate conversions. With filtRate 1
+ * the FIR runs on the raw conversions.
+ *
+ * This is a cheap filter, not a sharp one. The group sum has its zeros at
+ * the multiples of the output rate, the frequencies that fold onto DC when
+ * decimating, but only a sinc roll-off between them (the first sidelobe
+ * is 13 dB down); the FIR then rolls off toward half the output rate.
+ * Load changes faster than the output rate alias with little attenuation,
+ * so pick filtRate for noise averaging and keep the band of interest well
+ * below the output rate.
+ *
+ * Each of the HX_CELLS load cells has its own filter state; all of them
+ * share the rate and order. All arithmetic is in long ints; no floats.
+ *
+ */
+
+#ifndef FILTFUNKS_H_
+#define FILTFUNKS_H_
+
+#include "loadCellFunks.h"
+
+#define		FILT_MAX_RATE	64
+#define		FILT_MAX_ORDER	7		// 8 taps, 2^23 * 2^7 still fits a long
+
+
+extern unsigned char filtRate, filtOrder;
+
+int filtConfig(int, int);
+int filtPush(long int*, long int*);
+
+
+#endif /* FILTFUNKS_H_ */
@@ -0,0 +1,58 @@
+/*
+ * flashFunks.c
+ *
+ * Information flash erase and write, see flashFunks.h.
+ *
+ */
+
+#include "flashFunks.h"
+#include "clock.h"
+
+
+/*
+ *  === flashErase ===
+ *
+ *  Erases the information segment starting at seg.
+ *
+ */
+void flashErase(unsigned char* seg){
+	__disable_interrupt();
+	FCTL2 = FWKEY | FSSEL_1 | (FLASH_DIV-1);	// MCLK / FLASH_DIV
+	FCTL3 = FWKEY;								// unlock
+	FCTL1 = FWKEY | ERASE;
+	HAL_FLASH_WR(seg, 0);						// dummy write, CPU held until erased
+	FCTL3 = FWKEY | LOCK;
+	__enable_interrupt();
+}
+
+
+/*
+ *  === flashWrite ===
+ *
+ *  Writes n bytes from src to erased flash at dst. src may be in flash
+ *  itself, e.g. the other segment of a setting being copied. Returns 1 if
+ *  they do not read back (segment not erased, or worn out).
+ *
+ */
+int flashWrite(unsigned char* dst, const void* src, unsigned char n){
+	const unsigned char* s = src;
+	unsigned char i;
+
+	__disable_interrupt();
+	FCTL2 = FWKEY | FSSEL_1 | (FLASH_DIV-1);
+	FCTL3 = FWKEY;
+	FCTL1 = FWKEY | WRT;
+	for(i=0; i<n; i++){
+		HAL_FLASH_WR(&dst[i], s[i]);			// CPU held until written
+	}
+	FCTL1 = FWKEY;
+	FCTL3 = FWKEY | LOCK;
+	__enable_interrupt();
+
+	for(i=0; i<n; i++){
+		if(dst[i] != s[i]){
+			return 1;
+		}
+	}
+	return 0;
+}
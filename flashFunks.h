@@ -0,0 +1,32 @@
+/*
+ * flashFunks.h - Information flash writes
+ *
+ * The G2553 has four 64 byte information segments, D, C, B and A from
+ * 0x1000 up (HAL_INFO_x in hal.h; A holds the factory calibration and is
+ * never written). Settings kept there are read in place and take no RAM.
+ * A segment can only be erased as a whole, to 0xFF, and writing a byte can
+ * only clear bits, so a setting is changed by erasing and rewriting its
+ * segment.
+ *
+ * The CPU is held while the flash controller works, about 15 ms per erase
+ * and 90 us per byte at FLASH_HZ (clock.h), and interrupts are held off:
+ * a conversion may be missed and a temp/humidity read fail, so settings
+ * are best saved with the rig at rest. UART RX bytes are lost too: the
+ * USCI holds one byte, and at 115200 baud an erase spans some 170, so the
+ * host must wait for the answer before sending the next command.
+ *
+ */
+
+#ifndef FLASHFUNKS_H_
+#define FLASHFUNKS_H_
+
+#include "hal.h"
+
+#define		FLASH_SEG		64			// bytes per information segment
+
+
+void flashErase(unsigned char*);
+int flashWrite(unsigned char*, const void*, unsigned char);
+
+
+#endif /* FLASHFUNKS_H_ */
@@ -0,0 +1,73 @@
+/*
+ * fmtFunks.c
+ *
+ * Table-driven decimal formatting, see fmtFunks.h.
+ *
+ */
+
+#include "fmtFunks.h"
+
+const unsigned long int pow10_32[9] = { 1000000000, 100000000, 10000000, 1000000, 100000,
+		10000, 1000, 100, 10 };
+
+
+/*
+ *  === fmtDec ===
+ *
+ *  Writes the lowest 'digits' decimal digits of val to dst, zero padded,
+ *  e.g. fmtDec(2450, dst, 8) = "00002450". Each digit costs at most nine
+ *  compares and subtracts; once val fits 16 bits the loop switches to 16
+ *  bit arithmetic (unsigned short, so the host build does the same).
+ *
+ */
+void fmtDec(unsigned long int val, unsigned char* dst, unsigned char digits){
+	unsigned char i, d, pos;
+	unsigned short val16;
+
+	for(i=0; i<9; i++){
+		pos = 9-i;							// digit position counted from the right
+		if(val < 65536){
+			break;
+		}
+		d = '0';
+		while(val >= pow10_32[i]){
+			val -= pow10_32[i];
+			d++;
+		}
+		if(pos < digits)(dst[digits-1-pos] = d);
+	}
+
+	val16 = val;
+	for(; i<9; i++){
+		pos = 9-i;
+		d = '0';
+		if(i >= 5){							// 10^4 and down, the digits above are 0
+			while(val16 >= (unsigned short)pow10_32[i]){
+				val16 -= (unsigned short)pow10_32[i];
+				d++;
+			}
+		}
+		if(pos < digits)(dst[digits-1-pos] = d);
+	}
+
+	dst[digits-1] = '0'+val16;
+}
+
+
+/*
+ *  === fmtSigned ===
+ *
+ *  Writes a sign character ('-' or '0') followed by 'digits' digits of
+ *  |val|, the layout used by conv_hex_dec and the temperature field.
+ *
+ */
+void fmtSigned(long int val, unsigned char* dst, unsigned char digits){
+	if(val < 0){
+		dst[0] = '-';
+		val = -val;
+	}
+	else{
+		dst[0] = '0';
+	}
+	fmtDec(val, dst+1, digits);
+}
@@ -0,0 +1,18 @@
+/*
+ * fmtFunks.h - Decimal formatting
+ *
+ * Fixed-width decimal conversion shared by the frame encoders and the
+ * serial handler. The MSP430G2 has no hardware divider, so digits are
+ * found by subtracting powers of ten instead of with / and %.
+ *
+ */
+
+#ifndef FMTFUNKS_H_
+#define FMTFUNKS_H_
+
+
+void fmtDec(unsigned long int, unsigned char*, unsigned char);
+void fmtSigned(long int, unsigned char*, unsigned char);
+
+
+#endif /* FMTFUNKS_H_ */
@@ -0,0 +1,180 @@
+/*
+ * frameFunks.c
+ *
+ * Packs samples into the binary frame described in frameFunks.h. Frames
+ * are built in tx_data_str and sent with uart_write_raw(), as the ASCII
+ * frame is with uart_write_string().
+ *
+ */
+
+#include "frameFunks.h"
+#include "serial_handler.h"
+
+unsigned char frameMode = MODE_ASCII;		// selected with the 'B' command
+
+
+/*
+ *  === frameSample ===
+ *
+ *  Builds a sample frame in tx_data_str and returns its total length
+ *  (header, payload and crc).
+ *
+ */
+int frameSample(long int* load, volatile char* thData, unsigned int battMv, unsigned char flags,
+		unsigned char hxseq, unsigned long time){
+	unsigned char i = 0, c;
+
+	tx_data_str[i++] = FRAME_SYNC;
+	tx_data_str[i++] = FRAME_T_SAMPLE;
+	tx_data_str[i++] = 7 + FRAME_STAMP_LENG + 3*HX_CELLS;
+
+	for(c=0; c<HX_CELLS; c++){
+		tx_data_str[i++] = load[c]>>16;
+		tx_data_str[i++] = load[c]>>8;
+		tx_data_str[i++] = load[c];
+	}
+
+	tx_data_str[i++] = thData[0];		// RH
+	tx_data_str[i++] = thData[1];
+	tx_data_str[i++] = thData[2];		// temp
+	tx_data_str[i++] = thData[3];
+
+	tx_data_str[i++] = battMv>>8;
+	tx_data_str[i++] = battMv;
+	tx_data_str[i++] = flags;
+	i = frameStamp(i, hxseq, time);
+
+	tx_data_str[i] = crc8(&tx_data_str[1], i-1);	// crc excludes sync byte
+
+	return i+1;
+}
+
+
+/*
+ *  === frameBlock ===
+ *
+ *  Builds a block frame from leng bytes of packed loads in tx_data_str and
+ *  returns its total length. leng must not exceed uart_max-11.
+ *
+ */
+int frameBlock(unsigned char* loads, unsigned char leng, unsigned char seq, unsigned char src,
+		unsigned char hxseq, unsigned long time){
+	unsigned char i = 0, c;
+
+	tx_data_str[i++] = FRAME_SYNC;
+	tx_data_str[i++] = FRAME_T_BLOCK;
+	tx_data_str[i++] = 2 + FRAME_STAMP_LENG + leng;
+	tx_data_str[i++] = seq;
+	tx_data_str[i++] = FRAME_F_SRC(src) | HX_CELLS;
+	i = frameStamp(i, hxseq, time);
+
+	for(c=0; c<leng; c++){
+		tx_data_str[i++] = loads[c];
+	}
+
+	tx_data_str[i] = crc8(&tx_data_str[1], i-1);
+
+	return i+1;
+}
+
+
+/*
+ *  === frameEvent ===
+ *
+ *  Builds an event frame from leng bytes of a trigger record in
+ *  tx_data_str and returns its total length.
+ *
+ */
+int frameEvent(unsigned char* loads, unsigned char leng, unsigned char rec, signed char idx, unsigned char src,
+		unsigned char hxseq, unsigned long time){
+	unsigned char i = 0, c;
+
+	tx_data_str[i++] = FRAME_SYNC;
+	tx_data_str[i++] = FRAME_T_EVENT;
+	tx_data_str[i++] = 3 + FRAME_STAMP_LENG + leng;
+	tx_data_str[i++] = rec;
+	tx_data_str[i++] = idx;
+	tx_data_str[i++] = FRAME_F_SRC(src) | HX_CELLS;
+	i = frameStamp(i, hxseq, time);
+
+	for(c=0; c<leng; c++){
+		tx_data_str[i++] = loads[c];
+	}
+
+	tx_data_str[i] = crc8(&tx_data_str[1], i-1);
+
+	return i+1;
+}
+
+
+/*
+ *  === frameDelta ===
+ *
+ *  Builds a delta frame from leng bytes of keyframe values and varints
+ *  for n conversions in tx_data_str and returns its total length.
+ *
+ */
+int frameDelta(unsigned char* deltas, unsigned char leng, unsigned char seq, unsigned char info, unsigned char n,
+		unsigned char hxseq, unsigned long time){
+	unsigned char i = 0, c;
+
+	tx_data_str[i++] = FRAME_SYNC;
+	tx_data_str[i++] = FRAME_T_DELTA;
+	tx_data_str[i++] = 3 + FRAME_STAMP_LENG + leng;
+	tx_data_str[i++] = seq;
+	tx_data_str[i++] = info;
+	tx_data_str[i++] = n;
+	i = frameStamp(i, hxseq, time);
+
+	for(c=0; c<leng; c++){
+		tx_data_str[i++] = deltas[c];
+	}
+
+	tx_data_str[i] = crc8(&tx_data_str[1], i-1);
+
+	return i+1;
+}
+
+
+/*
+ *  === frameStamp ===
+ *
+ *  Writes the stamp of a conversion (sequence number and tick count) to
+ *  tx_data_str[i...] and returns the index after it.
+ *
+ */
+int frameStamp(unsigned char i, unsigned char hxseq, unsigned long time){
+	tx_data_str[i++] = hxseq;
+	tx_data_str[i++] = time>>24;
+	tx_data_str[i++] = time>>16;
+	tx_data_str[i++] = time>>8;
+	tx_data_str[i++] = time;
+	return i;
+}
+
+
+/*
+ *  === crc8 ===
+ *
+ *  CRC-8, polynomial x^8+x^2+x+1 (0x07), initial value 0. Computed bitwise
+ *  to keep the 256 byte table out of flash.
+ *
+ */
+unsigned char crc8(unsigned char* buf, int leng){
+	unsigned char crc = 0, bit;
+	int i;
+
+	for(i=0; i<leng; i++){
+		crc ^= buf[i];
+		for(bit=0; bit<8; bit++){
+			if(crc & 0x80){
+				crc = (crc<<1) ^ 0x07;
+			}
+			else{
+				crc <<= 1;
+			}
+		}
+	}
+
+	return crc;
+}
@@ -0,0 +1,107 @@
+/*
+ * frameFunks.h - Binary frame encoder
+ *
+ * Binary frames sent to the computer have the structure:
+ *
+ * 		| A5 | type | len | payload (len bytes) | crc |
+ *
+ * Where A5 is the sync byte, len is the number of payload bytes and
+ * crc is a CRC-8 (poly 0x07, init 0) over type, len and payload. All
+ * multi-byte fields are sent MSB first.
+ *
+ * Every frame carries the stamp of one HX711 conversion (see
+ * loadCellFunks.h), 5 bytes:
+ *
+ * 		hxseq | time[4]
+ *
+ * 		hxseq	sequence number of the conversion, counts every conversion
+ * 				read (wraps at 256), so gaps show dropped conversions
+ * 		time	TA1 tick count when it was read, TA_HZ (250 kHz), wraps
+ * 				after 4.7 hours (tickFunks.h)
+ *
+ * Sample payload (FRAME_T_SAMPLE, 12 + 3*HX_CELLS bytes, so the frame is
+ * 16 + 3*HX_CELLS bytes; the ASCII frame is roughly twice that):
+ *
+ * 		load[3] ... load[3] | rh[2] | temp[2] | batt[2] | flags | stamp[5]
+ *
+ * 		load	24-bit two's complement load cell value, one per cell
+ * 		rh		relative humidity*10 (thBuffer[0..1])
+ * 		temp	temperature*10, bit 15 is sign (thBuffer[2..3], thTemp())
+ * 		batt	battery voltage in mV
+ * 		flags	FRAME_F_TH_NEW / FRAME_F_TH_ERR / FRAME_F_CAL (loads in the
+ * 				unit set with N, calFunks.h, not counts) / FRAME_F_TC (loads
+ * 				temperature compensated, tcFunks.h), bits 4-5 are the
+ * 				source of the loads (HX_SRC: 0 = A128, 1 = A64, 2 = B32)
+ * 		stamp	the last conversion that went into the loads
+ *
+ * Block payload (FRAME_T_BLOCK, 7 + 3*HX_CELLS*n bytes, burst mode):
+ *
+ * 		seq | src/cells | stamp[5] | load[3] ... load[3]
+ *
+ * 		seq			block counter, increments by one per block so the
+ * 					computer can spot blocks lost to a full TX ring
+ * 		src/cells	bits 4-5 source (as in flags), bits 0-2 HX_CELLS
+ * 		stamp		the first conversion, the k-th has hxseq + k
+ * 		load		n consecutive raw conversions, HX_CELLS values each,
+ * 					oldest first
+ *
+ * Event payload (FRAME_T_EVENT, 8 + 3*HX_CELLS*n bytes, trigger record):
+ *
+ * 		rec | idx | src/cells | stamp[5] | load[3] ... load[3]
+ *
+ * 		rec			record number, increments each time the trigger is armed
+ * 		idx			signed position of the first conversion relative to the
+ * 					one that fired the trigger (0), negative = pre-trigger
+ * 		src/cells	as in the block frame
+ * 		stamp		the conversion that fired the trigger (idx 0)
+ * 		load		n consecutive raw conversions, HX_CELLS values each
+ *
+ * Delta payload (FRAME_T_DELTA, 8 + up to DELTA_BYTES bytes, delta mode):
+ *
+ * 		seq | src/cells | n | stamp[5] | [key[3] ... key[3]] | varint ... varint
+ *
+ * 		seq			as in the block frame
+ * 		src/cells	as in the block frame, bit 7 (DELTA_F_KEY) marks a keyframe
+ * 		n			number of conversions in the frame
+ * 		stamp		as in the block frame
+ * 		key			keyframes only, the first conversion as 24-bit values
+ * 		varint		zig-zag varint deltas to the previous conversion, HX_CELLS
+ * 					per conversion (see deltaFunks.h)
+ *
+ */
+
+#ifndef FRAMEFUNKS_H_
+#define FRAMEFUNKS_H_
+
+#include "loadCellFunks.h"
+
+#define		FRAME_SYNC		0xA5
+#define		FRAME_T_SAMPLE	0x01
+#define		FRAME_T_BLOCK	0x02
+#define		FRAME_T_EVENT	0x03
+#define		FRAME_T_DELTA	0x04
+#define		FRAME_HDR_LENG	3		// sync, type, len
+#define		FRAME_STAMP_LENG	5		// hxseq, time
+#define		FRAME_F_TH_NEW	0x01	// temp/humidity fields were refreshed
+#define		FRAME_F_TH_ERR	0x02	// last temp/humidity read failed
+#define		FRAME_F_CAL		0x04	// loads are grams or mN, see calFunks.h
+#define		FRAME_F_TC		0x08	// loads are temperature compensated, see tcFunks.h
+#define		FRAME_F_SRC(s)	((s)<<4)	// HX711 channel/gain of the loads
+
+#define		MODE_ASCII		0
+#define		MODE_BINARY		1
+#define		MODE_BURST		2		// binary frames plus block frames
+#define		MODE_DELTA		3		// binary frames plus delta frames
+
+
+extern unsigned char frameMode;
+
+int frameSample(long int*, volatile char*, unsigned int, unsigned char, unsigned char, unsigned long);
+int frameBlock(unsigned char*, unsigned char, unsigned char, unsigned char, unsigned char, unsigned long);
+int frameEvent(unsigned char*, unsigned char, unsigned char, signed char, unsigned char, unsigned char, unsigned long);
+int frameDelta(unsigned char*, unsigned char, unsigned char, unsigned char, unsigned char, unsigned char, unsigned long);
+int frameStamp(unsigned char, unsigned char, unsigned long);
+unsigned char crc8(unsigned char*, int);
+
+
+#endif /* FRAMEFUNKS_H_ */
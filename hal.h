@@ -0,0 +1,43 @@
+/*
+ * hal.h - Hardware abstraction
+ *
+ * Firmware sources include this instead of <msp430.h>. On the target it
+ * is just the TI device header. Built with HOST_SIM defined (see sim/)
+ * the same register names, intrinsics and interrupt vectors resolve to the
+ * Linux simulator, so the unmodified main loop runs on a PC.
+ *
+ * 		HAL_ADDR(x)		16 bit address of a RAM buffer, for DMA style
+ * 						registers such as ADC10SA
+ * 		HAL_INFO_D/C/B	start of the information flash segments, 64 bytes
+ * 						each (flashFunks.h). Segment A holds the factory
+ * 						calibration and is left alone.
+ * 		HAL_FLASH_WR(p, b)	writes byte b to flash at p, with the flash
+ * 						controller set up for an erase or a write
+ *
+ */
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#ifdef HOST_SIM
+
+#include "sim/sim.h"
+#define		HAL_ADDR(x)		sim_addr(x)
+#define		HAL_INFO_D		(&sim_info[0x00])
+#define		HAL_INFO_C		(&sim_info[0x40])
+#define		HAL_INFO_B		(&sim_info[0x80])
+#define		HAL_FLASH_WR(p, b)	sim_flash_wr(p, b)
+
+#else
+
+#include <msp430.h>
+#define		HAL_ADDR(x)		((unsigned int)(x))
+#define		HAL_INFO_D		((unsigned char*)0x1000)
+#define		HAL_INFO_C		((unsigned char*)0x1040)
+#define		HAL_INFO_B		((unsigned char*)0x1080)
+#define		HAL_FLASH_WR(p, b)	(*(volatile unsigned char*)(p) = (b))	// never dropped or merged
+
+#endif
+
+
+#endif /* HAL_H_ */
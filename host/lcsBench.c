@@ -0,0 +1,100 @@
+/*
+ * lcsBench.c - Compression benchmark for the delta mode
+ *
+ *   lcsBench capture
+ *
+ * Decodes a capture taken in delta mode (B003) or burst mode (B002) and
+ * reports the bytes per conversion actually sent, the compression ratio
+ * against the ASCII and raw binary encodings, and the conversion rate each
+ * encoding can sustain at every baud rate of the 'U' command. The rates
+ * count the streamed frames only; the periodic sample frames (19 bytes with
+ * one cell) come on top.
+ *
+ * E.g. with the simulator:
+ *
+ *   SIM_QUIET=1 SIM_SECONDS=30 SIM_INPUT='G\n\w\wB3\n' SIM_TXLOG=cap.bin ../sim/loadCellSim
+ *   ./lcsBench cap.bin
+ *
+ */
+
+#include <stdio.h>
+
+#include "lcsFrame.h"
+
+#define		HX_SPS_MAX		80			// HX711 with RATE high
+
+static const unsigned long bps[] = {300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200};
+
+static int cells = 1;
+
+
+static void countCells(void* ctx, const lcsConv* cv){
+	cells = cv->cells;
+}
+
+static void rateRow(const char* name, double bpc){
+	unsigned i;
+
+	printf("%-22s %6.2f", name, bpc);
+	for(i=0; i<sizeof(bps)/sizeof(bps[0]); i++){
+		printf(" %7.0f", bps[i]/10.0/bpc);			// start, 8 data, stop
+	}
+	printf("\n");
+}
+
+int main(int argc, char** argv){
+	FILE* in;
+	unsigned char buf[512];
+	lcsParser p;
+	size_t n;
+	unsigned i;
+	int sets;
+	double ascii, raw, delta = 0, block = 0;
+
+	if(argc < 2){
+		fprintf(stderr, "usage: %s capture\n", argv[0]);
+		return 2;
+	}
+	if(!(in = fopen(argv[1], "rb"))){
+		perror(argv[1]);
+		return 1;
+	}
+
+	lcsInit(&p);
+	while((n = fread(buf, 1, sizeof(buf), in)) > 0){
+		lcsFeed(&p, buf, n, countCells, 0);
+	}
+
+	// ASCII frame per conversion (22 + 9 per extra cell, \n\r) and packed 24-bit
+	ascii = 26 + 9*(cells-1);
+	sets = (cells == 1) ? 7 : 12/cells - 1;
+	raw = (3.0*cells*sets + 11) / sets;				// block frames, see burstFunks.h
+	if(p.conversions[LCS_T_DELTA]){
+		delta = (double)p.frameBytes[LCS_T_DELTA] / p.conversions[LCS_T_DELTA];
+	}
+	if(p.conversions[LCS_T_BLOCK]){
+		block = (double)p.frameBytes[LCS_T_BLOCK] / p.conversions[LCS_T_BLOCK];
+	}
+
+	printf("capture: %d cell(s), %lu delta frames (%lu conversions), %lu block frames (%lu conversions)\n",
+			cells, p.frames[LCS_T_DELTA], p.conversions[LCS_T_DELTA],
+			p.frames[LCS_T_BLOCK], p.conversions[LCS_T_BLOCK]);
+	printf("         %lu crc errors, %lu delta conversions lost\n\n", p.crcErrors, p.deltaLost);
+	if(!delta && !block){
+		printf("no delta or block frames in the capture\n");
+		return 1;
+	}
+	if(delta){
+		printf("compression: %.2f bytes/conversion, %.2fx vs ASCII, %.2fx vs raw blocks\n\n",
+				delta, ascii/delta, raw/delta);
+	}
+
+	printf("conversions/s at baud  B/conv");
+	for(i=0; i<sizeof(bps)/sizeof(bps[0]); i++)(printf(" %7lu", bps[i]));
+	printf("\n");
+	rateRow("ASCII frame (nominal)", ascii);
+	rateRow(block ? "raw blocks (measured)" : "raw blocks (nominal)", block ? block : raw);
+	if(delta)(rateRow("delta (measured)", delta));
+	printf("\nthe HX711 converts at most %d times/s\n", HX_SPS_MAX);
+	return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * lcsDecode.c - Print the load conversions in a captured byte stream
+ *
+ *   lcsDecode [capture]      (stdin if omitted)
+ *
+ * One line per conversion, "type,src,seq,time,load[,load...]", with the
+ * frame type letter a(scii), s(ample, S if the loads are grams or mN rather
+ * than counts), b(lock), e(vent) or d(elta), and the time
+ * in seconds since the sampler was powered up, '~' in front if it was
+ * extrapolated (see lcsFrame.h). A summary goes to stderr.
+ * A capture can be taken from the sampler with e.g.
+ *
+ *   stty -F /dev/ttyUSB0 9600 raw; cat /dev/ttyUSB0 > capture.bin
+ *
+ * or from the simulator with SIM_TXLOG (see ../sim/sim.c).
+ *
+ */
+
+#include <stdio.h>
+
+#include "lcsFrame.h"
+
+
+static void printLoad(void* ctx, const lcsConv* cv){
+	int c;
+
+	printf("%c,%d,%d,%s%.6f", cv->cal ? 'S' : "asbed"[cv->type], cv->src, cv->seq, cv->stamped ? "" : "~",
+			(double)cv->time / LCS_TICK_HZ);
+	for(c=0; c<cv->cells; c++)(printf(",%ld", cv->load[c]));
+	printf("\n");
+}
+
+int main(int argc, char** argv){
+	FILE* in = stdin;
+	unsigned char buf[512];
+	lcsParser p;
+	size_t n;
+
+	if(argc > 1 && !(in = fopen(argv[1], "rb"))){
+		perror(argv[1]);
+		return 1;
+	}
+
+	lcsInit(&p);
+	while((n = fread(buf, 1, sizeof(buf), in)) > 0){
+		lcsFeed(&p, buf, n, printLoad, 0);
+	}
+
+	fprintf(stderr, "frames: %lu ascii, %lu sample, %lu block, %lu event, %lu delta, %lu crc errors, %lu bad ascii\n",
+			p.frames[LCS_T_ASCII], p.frames[LCS_T_SAMPLE], p.frames[LCS_T_BLOCK], p.frames[LCS_T_EVENT],
+			p.frames[LCS_T_DELTA], p.crcErrors, p.asciiErrors);
+	fprintf(stderr, "delta conversions lost waiting for a keyframe: %lu\n", p.deltaLost);
+	fprintf(stderr, "conversions missing from block/delta frames: %lu\n", p.seqGaps);
+	return 0;
+}
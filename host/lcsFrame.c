@@ -0,0 +1,403 @@
+/*
+ * lcsFrame.c
+ *
+ * Frame parser and delta decoder, see lcsFrame.h.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lcsFrame.h"
+
+
+void lcsInit(lcsParser* p){
+	memset(p, 0, sizeof(*p));
+	p->deltaSeq = -1;
+	p->lastSeq = -1;
+	p->nextSeq = -1;
+}
+
+
+static unsigned char crc8(const unsigned char* b, int n){
+	unsigned char c = 0;
+	int i, k;
+	for(i=0; i<n; i++){
+		c ^= b[i];
+		for(k=0; k<8; k++)(c = (c & 0x80) ? (c<<1)^0x07 : c<<1);
+	}
+	return c;
+}
+
+static long get24(const unsigned char* b){
+	long v = ((long)b[0]<<16) | (b[1]<<8) | b[2];
+	return (v & 0x00800000) ? v - 0x01000000 : v;
+}
+
+
+/*
+ *  === stamp ===
+ *
+ *  Reads a stamp (hxseq | time[4]) into cv and unwraps the time. Stamps of
+ *  sample, block and delta frames are current and also measure the period;
+ *  event frames send older ones.
+ *
+ */
+static void stamp(lcsParser* p, const unsigned char* st, int current, lcsConv* cv){
+	uint32_t t = ((uint32_t)st[1]<<24) | ((uint32_t)st[2]<<16) | (st[3]<<8) | st[4];
+	unsigned long long t64 = t;
+	double per;
+	int d;
+
+	if(p->lastSeq >= 0){
+		t64 = p->lastTime + (int32_t)(t - p->lastStamp);	// nearest, stamps are < 2^31 ticks apart
+	}
+	cv->seq = st[0];
+	cv->time = t64;
+	cv->stamped = 1;
+
+	if(!current){
+		return;
+	}
+	if(p->lastSeq >= 0 && t64 > p->lastTime){
+		d = (st[0] - p->lastSeq) & 0xFF;
+		per = d ? (double)(t64 - p->lastTime) / d : 0;
+		if(per >= LCS_TICK_HZ/100 && per <= LCS_TICK_HZ/5){		// 5-100 conversions/s, else seq wrapped
+			p->period = per;
+		}
+	}
+	p->lastSeq = st[0];
+	p->lastStamp = t;
+	p->lastTime = t64;
+}
+
+// conversion k of a frame whose stamp is conversion k0
+static void emit(lcsConv* cv, const lcsConv* st, int k, int k0, lcsLoadFn fn, void* ctx, const lcsParser* p){
+	cv->seq = (st->seq + k - k0) & 0xFF;
+	cv->time = st->time + (long long)((k - k0) * p->period);
+	cv->stamped = (k == k0);
+	if(fn)(fn(ctx, cv));
+}
+
+// first conversion of a block or delta frame, counts the conversions missed before it
+static void follow(lcsParser* p, int seq, int n){
+	if(p->nextSeq >= 0 && seq != p->nextSeq){
+		p->seqGaps += (seq - p->nextSeq) & 0xFF;
+	}
+	p->nextSeq = (seq + n) & 0xFF;
+}
+
+
+/*
+ *  === decodeDelta ===
+ *
+ *  Payload: seq | src/cells | n | stamp | [key] | varints. Returns the
+ *  number of conversions decoded.
+ *
+ */
+static int decodeDelta(lcsParser* p, const unsigned char* pl, int leng, lcsLoadFn fn, void* ctx){
+	int seq = pl[0], n = pl[2];
+	int i = 3+LCS_STAMP_LENG, k, c, shift;
+	unsigned long z;
+	lcsConv cv, st;
+
+	cv.type = LCS_T_DELTA;
+	cv.cal = 0;
+	cv.tc = 0;
+	cv.temp = LCS_NO_TEMP;
+	cv.rh = -1;
+	cv.batt = -1;
+	cv.src = (pl[1]>>4) & 0x03;
+	cv.cells = pl[1] & 0x07;
+	if(cv.cells < 1 || cv.cells > LCS_MAX_CELLS){
+		return 0;
+	}
+	stamp(p, &pl[3], 1, &st);
+	follow(p, st.seq, n);
+	if(!(pl[1] & LCS_F_KEY) && (!p->deltaSynced || seq != ((p->deltaSeq+1) & 0xFF))){
+		p->deltaSynced = 0;					// wait for a keyframe
+		p->deltaSeq = seq;
+		p->deltaLost += n;
+		return 0;
+	}
+	p->deltaSeq = seq;
+
+	for(k=0; k<n; k++){
+		for(c=0; c<cv.cells; c++){
+			if(k == 0 && (pl[1] & LCS_F_KEY)){
+				if(i+3 > leng){
+					goto bad;
+				}
+				p->prev[c] = get24(&pl[i]);
+				i += 3;
+				continue;
+			}
+			z = 0;
+			shift = 0;
+			do{
+				if(i >= leng || shift > 28){
+					goto bad;
+				}
+				z |= (unsigned long)(pl[i] & 0x7F) << shift;
+				shift += 7;
+			}while(pl[i++] & 0x80);
+			p->prev[c] += (z & 1) ? -(long)(z>>1) - 1 : (long)(z>>1);
+			p->prev[c] = ((p->prev[c] + 0x00800000) & 0x00FFFFFF) - 0x00800000;
+		}
+		memcpy(cv.load, p->prev, sizeof(cv.load));
+		emit(&cv, &st, k, 0, fn, ctx, p);
+	}
+	p->deltaSynced = 1;
+	return n;
+
+bad:
+	p->deltaSynced = 0;
+	p->deltaLost += n - k;
+	return k;
+}
+
+
+/*
+ *  === decodeFrame ===
+ *
+ *  Dispatches a frame that passed the crc check.
+ *
+ */
+static int decodeFrame(lcsParser* p, int type, const unsigned char* pl, int leng, lcsLoadFn fn, void* ctx){
+	lcsConv cv, st;
+	int hdr, n = 0, c, i, k0;
+
+	cv.type = type;
+	cv.cal = 0;
+	cv.tc = 0;
+	cv.temp = LCS_NO_TEMP;
+	cv.rh = -1;
+	cv.batt = -1;
+	switch(type){
+	case LCS_T_SAMPLE:						// loads | rh | temp | batt | flags | stamp
+		cv.cells = (leng - 7 - LCS_STAMP_LENG) / 3;
+		if(cv.cells < 1 || cv.cells > LCS_MAX_CELLS){
+			return 0;
+		}
+		for(c=0; c<cv.cells; c++)(cv.load[c] = get24(&pl[3*c]));
+		cv.src = (pl[3*cv.cells+6]>>4) & 0x03;
+		cv.cal = (pl[3*cv.cells+6] & LCS_F_CAL) != 0;
+		cv.tc = (pl[3*cv.cells+6] & LCS_F_TC) != 0;
+		i = (pl[3*cv.cells+2] << 8) | pl[3*cv.cells+3];
+		if(i != 0 || pl[3*cv.cells] != 0 || pl[3*cv.cells+1] != 0){		// all zero before the first reading
+			cv.temp = (i & 0x8000) ? -(i & 0x7FFF) : i;
+			cv.rh = (pl[3*cv.cells] << 8) | pl[3*cv.cells+1];
+		}
+		cv.batt = (pl[3*cv.cells+4] << 8) | pl[3*cv.cells+5];
+		stamp(p, &pl[3*cv.cells+7], 1, &st);
+		emit(&cv, &st, 0, 0, fn, ctx, p);
+		return 1;
+	case LCS_T_BLOCK:						// seq | src/cells | stamp | loads
+	case LCS_T_EVENT:						// rec | idx | src/cells | stamp | loads
+		hdr = (type == LCS_T_BLOCK) ? 2 : 3;
+		if(leng < hdr+LCS_STAMP_LENG){
+			return 0;
+		}
+		cv.cells = pl[hdr-1] & 0x07;
+		cv.src = (pl[hdr-1]>>4) & 0x03;
+		if(cv.cells < 1 || cv.cells > LCS_MAX_CELLS){
+			return 0;
+		}
+		stamp(p, &pl[hdr], type == LCS_T_BLOCK, &st);
+		k0 = (type == LCS_T_BLOCK) ? 0 : -(signed char)pl[1];		// the stamp is idx 0
+		if(type == LCS_T_BLOCK)(follow(p, st.seq, (leng-hdr-LCS_STAMP_LENG) / (3*cv.cells)));
+		for(i=hdr+LCS_STAMP_LENG; i+3*cv.cells <= leng; i+=3*cv.cells, n++){
+			for(c=0; c<cv.cells; c++)(cv.load[c] = get24(&pl[i+3*c]));
+			emit(&cv, &st, n, k0, fn, ctx, p);
+		}
+		return n;
+	case LCS_T_DELTA:
+		return (leng >= 3+LCS_STAMP_LENG) ? decodeDelta(p, pl, leng, fn, ctx) : 0;
+	}
+	return 0;
+}
+
+
+/*
+ *  === asciiField ===
+ *
+ *  Reads a number of an ASCII frame, zero padded, the sign may follow the
+ *  padding ("00-52000", "-235"). Returns 0 if it is not one.
+ *
+ */
+static int asciiField(const unsigned char* f, int w, long long* v){
+	int i = 0, neg = 0;
+
+	while(i < w-1 && f[i] == '0')(i++);
+	if(f[i] == '-'){
+		neg = 1;
+		i++;
+	}
+	if(i == w){
+		return 0;
+	}
+	for(*v=0; i<w; i++){
+		if(f[i] < '0' || f[i] > '9'){
+			return 0;
+		}
+		*v = *v*10 + f[i] - '0';
+	}
+	if(neg)(*v = -*v);
+	return 1;
+}
+
+
+/*
+ *  === decodeAscii ===
+ *
+ *  Line: load[8],... rh[3],temp[4],batt[4],[seq[3],time[10],][gain[3],]
+ *  without the leading NUL and the \n. rh and temp are "XXX"/"EXX" and
+ *  "XXXX" when they were not just read. Returns 0 if a field is malformed.
+ *
+ */
+static int decodeAscii(lcsParser* p, const unsigned char* s, int leng, lcsLoadFn fn, void* ctx){
+	const unsigned char* f[LCS_MAX_CELLS+7];
+	int w[LCS_MAX_CELLS+7], nf = 0, i, start = 0, k;
+	unsigned char st[5];
+	long long v;
+	lcsConv cv, stc;
+
+	for(i=0; i<leng; i++){
+		if(s[i] == ','){
+			if(nf == LCS_MAX_CELLS+7){
+				return 0;
+			}
+			f[nf] = &s[start];
+			w[nf++] = i - start;
+			start = i+1;
+		}
+	}
+	if(start != leng){							// every field ends with ','
+		return 0;
+	}
+
+	cv.type = LCS_T_ASCII;
+	cv.src = 0;
+	cv.cal = 0;
+	cv.tc = 0;
+	for(k=0; k<nf && k<LCS_MAX_CELLS && w[k] == 8; k++){
+		if(!asciiField(f[k], 8, &v)){
+			return 0;
+		}
+		cv.load[k] = v;
+	}
+	cv.cells = k;
+	if(k < 1 || nf < k+3 || w[k] != 3 || w[k+1] != 4 || w[k+2] != 4){
+		return 0;
+	}
+	cv.rh = asciiField(f[k], 3, &v) ? v : -1;
+	cv.temp = (cv.rh >= 0 && asciiField(f[k+1], 4, &v)) ? v : LCS_NO_TEMP;
+	if(!asciiField(f[k+2], 4, &v)){
+		return 0;
+	}
+	cv.batt = v * 10;
+	k += 3;
+
+	if(nf-k >= 2 && w[k] == 3 && w[k+1] == 10){
+		if(!asciiField(f[k], 3, &v) || v > 255){
+			return 0;
+		}
+		st[0] = v;
+		if(!asciiField(f[k+1], 10, &v) || v > 0xFFFFFFFFLL){
+			return 0;
+		}
+		st[1] = v >> 24;
+		st[2] = v >> 16;
+		st[3] = v >> 8;
+		st[4] = v;
+		stamp(p, st, 1, &stc);
+		cv.seq = stc.seq;
+		cv.time = stc.time;
+		cv.stamped = 1;
+		k += 2;
+	}
+	else{
+		cv.seq = 0;
+		cv.time = 0;
+		cv.stamped = 0;
+	}
+	if(nf-k == 1 && w[k] == 3){
+		if(!asciiField(f[k], 3, &v)){
+			return 0;
+		}
+		cv.src = (v == 128) ? 0 : (v == 64) ? 1 : (v == 32) ? 2 : -1;
+		if(cv.src < 0){
+			return 0;
+		}
+		k++;
+	}
+	if(k != nf){
+		return 0;
+	}
+	if(fn)(fn(ctx, &cv));
+	return 1;
+}
+
+
+void lcsFeed(lcsParser* p, const unsigned char* bytes, int count, lcsLoadFn fn, void* ctx){
+	int i, leng, drop;
+
+	while(count > 0){
+		// top up the buffer
+		i = sizeof(p->buf) - p->leng;
+		if(i > count)(i = count);
+		memcpy(&p->buf[p->leng], bytes, i);
+		p->leng += i;
+		bytes += i;
+		count -= i;
+
+		for(;;){
+			// skip to the next sync byte or ASCII frame
+			for(drop=0; drop<p->leng && p->buf[drop] != LCS_SYNC && p->buf[drop] != 0; drop++);
+			p->skipped += drop;
+			memmove(p->buf, &p->buf[drop], p->leng - drop);
+			p->leng -= drop;
+
+			if(p->leng > 0 && p->buf[0] == 0){
+				for(i=1; i<p->leng && i<=LCS_ASCII_MAX && p->buf[i] != '\n'; i++);
+				if(i == p->leng && i <= LCS_ASCII_MAX){
+					break;							// rest of the line to come
+				}
+				if(i <= LCS_ASCII_MAX && decodeAscii(p, &p->buf[1], i-1, fn, ctx)){
+					leng = (i+1 < p->leng && p->buf[i+1] == '\r') ? i+2 : i+1;	// with the \r if it is in
+					p->frames[LCS_T_ASCII]++;
+					p->frameBytes[LCS_T_ASCII] += leng;
+					p->conversions[LCS_T_ASCII]++;
+				}
+				else{
+					p->asciiErrors++;
+					leng = 1;
+				}
+				memmove(p->buf, &p->buf[leng], p->leng - leng);
+				p->leng -= leng;
+				continue;
+			}
+
+			if(p->leng < 3){
+				break;
+			}
+			leng = p->buf[2] + 4;
+			if(p->buf[1] >= 1 && p->buf[1] <= 4 && p->leng < leng){
+				break;
+			}
+
+			if(p->buf[1] >= 1 && p->buf[1] <= 4 && crc8(&p->buf[1], leng-2) == p->buf[leng-1]){
+				p->frames[p->buf[1]]++;
+				p->frameBytes[p->buf[1]] += leng;
+				p->conversions[p->buf[1]] += decodeFrame(p, p->buf[1], &p->buf[3], leng-4, fn, ctx);
+			}
+			else{
+				p->crcErrors++;				// or an A5 outside a frame, rescan after it
+				p->deltaSynced = 0;
+				leng = 1;
+			}
+			memmove(p->buf, &p->buf[leng], p->leng - leng);
+			p->leng -= leng;
+		}
+	}
+}
@@ -0,0 +1,96 @@
+/*
+ * lcsFrame.h - Host side decoder for the loadCellSampler binary frames
+ *
+ * Feed the received bytes to lcsFeed() in chunks of any size. Binary frames
+ * (see ../frameFunks.h) are found by their sync byte and checked by length
+ * and crc, ASCII frames (see ../main.c) by their leading NUL and the width
+ * of every field; everything else (command replies) is skipped. For every
+ * load conversion a frame carries, the callback gets an lcsConv.
+ *
+ * Every frame is stamped with the sequence number and TA1 tick count of
+ * one conversion. The decoder unwraps the 32-bit tick count to 64 bits and
+ * numbers the other conversions of a block, delta or event frame from the
+ * stamp; their time is extrapolated with the conversion period measured
+ * between stamps. Conversions missing from the block and delta streams are
+ * counted in seqGaps.
+ *
+ * ASCII frames only carry the temperature and humidity when they were just
+ * read, and the source when several are scheduled (0 otherwise). With
+ * HX_CELLS = 4 they have no stamp: seq and time are 0 and stamped is not
+ * set.
+ *
+ * Delta frames are decoded against the previous conversion. After a
+ * sequence gap or a bad frame the decoder drops delta frames until the
+ * next keyframe; the dropped conversions are counted in deltaLost.
+ *
+ */
+
+#ifndef LCSFRAME_H_
+#define LCSFRAME_H_
+
+#define		LCS_SYNC		0xA5
+#define		LCS_T_ASCII		0x00		// not a binary type, an ASCII frame
+#define		LCS_T_SAMPLE	0x01
+#define		LCS_T_BLOCK		0x02
+#define		LCS_T_EVENT		0x03
+#define		LCS_T_DELTA		0x04
+#define		LCS_F_KEY		0x80
+#define		LCS_F_CAL		0x04		// sample flags, loads in grams or mN
+#define		LCS_F_TC		0x08		// loads temperature compensated
+#define		LCS_NO_TEMP		(-32768)	// temp of frames without a DHT reading
+#define		LCS_MAX_CELLS	4
+#define		LCS_STAMP_LENG	5
+#define		LCS_TICK_HZ		250000		// TA_HZ of the firmware
+#define		LCS_ASCII_MAX	80			// longest ASCII frame, NUL to \n
+
+typedef struct {
+	int type;							// LCS_T_xxx of the frame it came in
+	int src;							// HX_SRC: 0 = A128, 1 = A64, 2 = B32
+	int cells;
+	int seq;							// sequence number, 0-255
+	unsigned long long time;			// TA1 ticks, LCS_TICK_HZ
+	int stamped;						// time is the stamp, not extrapolated
+	int cal;							// loads are grams or mN (N command), not counts
+	int tc;								// loads are temperature compensated (t command)
+	int temp;							// sample frames, DHT temperature in 0.1 C, LCS_NO_TEMP if none
+	int rh;								// sample frames, relative humidity in 0.1 %, -1 if none
+	int batt;							// sample frames, battery voltage in mV, -1 if none
+	long load[LCS_MAX_CELLS];
+} lcsConv;
+
+typedef void (*lcsLoadFn)(void* ctx, const lcsConv* conv);
+
+typedef struct {
+	unsigned char buf[260];				// bytes not yet consumed
+	int leng;
+
+	long prev[LCS_MAX_CELLS];			// last delta conversion
+	int deltaSeq, deltaSynced;
+
+	unsigned long lastStamp;			// last sample, block or delta stamp
+	unsigned long long lastTime;		// the same, unwrapped
+	int lastSeq, nextSeq;				// -1 until known
+	double period;						// ticks per conversion, 0 until measured
+	unsigned long seqGaps;				// conversions missing from block and delta frames
+
+	unsigned long frames[5];			// good frames by type, [LCS_T_ASCII] ASCII
+	unsigned long frameBytes[5];
+	unsigned long crcErrors, skipped;	// bad frames, bytes outside frames
+	unsigned long asciiErrors;			// lines with a leading NUL that are not an ASCII frame
+	unsigned long conversions[5];		// by frame type
+	unsigned long deltaLost;			// delta conversions lost waiting for a keyframe
+} lcsParser;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void lcsInit(lcsParser*);
+void lcsFeed(lcsParser*, const unsigned char*, int, lcsLoadFn, void*);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* LCSFRAME_H_ */
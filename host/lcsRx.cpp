@@ -0,0 +1,362 @@
+/*
+ * lcsRx.cpp
+ *
+ * Reader thread and ring of the receiver, see lcsRx.h.
+ *
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "lcsRx.h"
+
+namespace lcs {
+
+#define		RX_CHUNK		65536		// bytes per read()
+#define		RX_POLL_MS		100			// how soon the reader sees stop()
+#define		RX_BATCH		256			// samples per pop of the callback thread
+
+// published by the reader after each read, any thread may load them
+struct Receiver::Counters {
+	std::atomic<uint64_t> bytes{0}, samples{0}, dropped{0}, frames[5], crcErrors{0}, asciiErrors{0},
+			skipped{0}, seqGaps{0}, deltaLost{0}, readErrors{0};
+	uint64_t samplesLocal = 0, droppedLocal = 0;		// reader only
+
+	Counters(){
+		for(auto& f : frames)(f = 0);
+	}
+};
+
+static speed_t bpsCode(unsigned long bps){
+	switch(bps){
+	case 300:		return B300;
+	case 1200:		return B1200;
+	case 2400:		return B2400;
+	case 4800:		return B4800;
+	case 9600:		return B9600;
+	case 19200:		return B19200;
+	case 38400:		return B38400;
+	case 57600:		return B57600;
+	case 115200:	return B115200;
+	default:		return B0;			// not a rate of the 'U' command
+	}
+}
+
+
+Receiver::Receiver(size_t ringSize) : ring_(ringSize), counters_(new Counters){
+	lcsInit(&parser_);
+}
+
+Receiver::~Receiver(){
+	close();
+}
+
+
+/*
+ *  === open ===
+ *
+ *  Opens path for reading and sending, read only if it cannot be written
+ *  (a capture file). A terminal is set to raw 8N1 at bps.
+ *
+ */
+bool Receiver::open(const std::string& path, unsigned long bps){
+	struct termios tio;
+	speed_t speed = bpsCode(bps);
+	int fd;
+
+	if(speed == B0){
+		error_ = "unsupported baud rate " + std::to_string(bps);
+		return false;
+	}
+	fd = ::open(path.c_str(), O_RDWR | O_NOCTTY);
+	if(fd < 0 && (errno == EACCES || errno == EISDIR || errno == EROFS)){
+		fd = ::open(path.c_str(), O_RDONLY | O_NOCTTY);
+	}
+	if(fd < 0){
+		error_ = path + ": " + strerror(errno);
+		return false;
+	}
+	if(isatty(fd)){
+		if(tcgetattr(fd, &tio) < 0){
+			error_ = path + ": " + strerror(errno);
+			::close(fd);
+			return false;
+		}
+		cfmakeraw(&tio);
+		tio.c_cflag |= CLOCAL | CREAD;
+		tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+		tio.c_cc[VMIN] = 1;
+		tio.c_cc[VTIME] = 0;
+		cfsetispeed(&tio, speed);
+		cfsetospeed(&tio, speed);
+		if(tcsetattr(fd, TCSANOW, &tio) < 0){
+			error_ = path + ": " + strerror(errno);
+			::close(fd);
+			return false;
+		}
+		tcflush(fd, TCIFLUSH);					// bytes from before we were listening
+	}
+	return attach(fd);
+}
+
+bool Receiver::attach(int fd){
+	close();
+	fd_ = fd;
+	return true;
+}
+
+void Receiver::close(){
+	stop();
+	if(fd_ >= 0){
+		::close(fd_);
+		fd_ = -1;
+	}
+}
+
+
+/*
+ *  === start ===
+ *
+ *  Starts the reader, and with a callback the thread that calls it. The
+ *  parser starts afresh, the counters keep counting.
+ *
+ */
+bool Receiver::start(Callback callback){
+	if(fd_ < 0){
+		error_ = "not open";
+		return false;
+	}
+	stop();
+	lcsInit(&parser_);
+	for(int i=0; i<5; i++)(parser_.frames[i] = counters_->frames[i]);		// counting on from an earlier start()
+	parser_.crcErrors = counters_->crcErrors;
+	parser_.asciiErrors = counters_->asciiErrors;
+	parser_.skipped = counters_->skipped;
+	parser_.seqGaps = counters_->seqGaps;
+	parser_.deltaLost = counters_->deltaLost;
+	callback_ = callback;
+	stop_ = false;
+	reading_ = true;
+	reader_ = std::thread(&Receiver::readLoop, this);
+	if(callback_)(caller_ = std::thread(&Receiver::callLoop, this));
+	return true;
+}
+
+void Receiver::stop(){
+	stop_ = true;
+	if(reader_.joinable())(reader_.join());
+	if(caller_.joinable())(caller_.join());
+}
+
+bool Receiver::running() const {
+	return reading_;
+}
+
+
+bool Receiver::send(const std::string& command){
+	std::string line = command + "\n";
+	size_t done = 0;
+	ssize_t n;
+
+	while(done < line.size()){
+		n = write(fd_, line.data() + done, line.size() - done);
+		if(n < 0 && errno == EINTR){
+			continue;
+		}
+		if(n <= 0){
+			error_ = std::string("send: ") + (n < 0 ? strerror(errno) : "nothing written");
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+
+size_t Receiver::pop(Sample* out, size_t max){
+	return ring_.pop(out, max);
+}
+
+/*
+ *  === popWait ===
+ *
+ *  pop, waiting up to timeout for the first sample. Returns 0 at the
+ *  timeout, or at once when the reader has ended and the ring is empty.
+ *
+ */
+size_t Receiver::popWait(Sample* out, size_t max, std::chrono::microseconds timeout){
+	auto end = std::chrono::steady_clock::now() + timeout;
+	unsigned spins = 0;
+	size_t n;
+
+	for(;;){
+		if((n = ring_.pop(out, max)) > 0){
+			return n;
+		}
+		if(!reading_){
+			return ring_.pop(out, max);			// the last ones may have come meanwhile
+		}
+		if(std::chrono::steady_clock::now() >= end){
+			return 0;
+		}
+		if(++spins < 64){
+			std::this_thread::yield();
+		}
+		else{
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+}
+
+
+RxStats Receiver::stats() const {
+	RxStats s;
+	int i;
+
+	s.bytes = counters_->bytes;
+	s.samples = counters_->samples;
+	s.dropped = counters_->dropped;
+	for(i=0; i<5; i++)(s.frames[i] = counters_->frames[i]);
+	s.crcErrors = counters_->crcErrors;
+	s.asciiErrors = counters_->asciiErrors;
+	s.skipped = counters_->skipped;
+	s.seqGaps = counters_->seqGaps;
+	s.deltaLost = counters_->deltaLost;
+	s.readErrors = counters_->readErrors;
+	return s;
+}
+
+const std::string& Receiver::lastError() const {
+	return error_;
+}
+
+
+/*
+ *  === onConv ===
+ *
+ *  lcsFeed callback, in the reader thread: packs a conversion and queues
+ *  it, never waits.
+ *
+ */
+void Receiver::onConv(void* ctx, const lcsConv* cv){
+	Receiver* rx = static_cast<Receiver*>(ctx);
+	Sample s;
+	int c;
+
+	s.time = cv->time;
+	for(c=0; c<LCS_MAX_CELLS; c++)(s.load[c] = (c < cv->cells) ? cv->load[c] : 0);
+	s.temp = cv->temp;
+	s.rh = cv->rh;
+	s.battMv = cv->batt;
+	s.seq = cv->seq;
+	s.type = cv->type;
+	s.src = cv->src;
+	s.cells = cv->cells;
+	s.flags = (cv->stamped ? SAMPLE_STAMPED : 0) | (cv->cal ? SAMPLE_CAL : 0) | (cv->tc ? SAMPLE_TC : 0);
+
+	if(rx->ring_.push(s)){
+		rx->counters_->samplesLocal++;
+	}
+	else{
+		rx->counters_->droppedLocal++;
+	}
+}
+
+// parser and reader counters to the atomics
+void Receiver::publish(){
+	Counters& k = *counters_;
+	int i;
+
+	k.samples.store(k.samplesLocal, std::memory_order_relaxed);
+	k.dropped.store(k.droppedLocal, std::memory_order_relaxed);
+	for(i=0; i<5; i++)(k.frames[i].store(parser_.frames[i], std::memory_order_relaxed));
+	k.crcErrors.store(parser_.crcErrors, std::memory_order_relaxed);
+	k.asciiErrors.store(parser_.asciiErrors, std::memory_order_relaxed);
+	k.skipped.store(parser_.skipped, std::memory_order_relaxed);
+	k.seqGaps.store(parser_.seqGaps, std::memory_order_relaxed);
+	k.deltaLost.store(parser_.deltaLost, std::memory_order_relaxed);
+}
+
+
+/*
+ *  === readLoop ===
+ *
+ *  The reader thread: polls the device so stop() is seen within
+ *  RX_POLL_MS, parses whatever came in one go. Ends at stop(), the end of
+ *  a file or pipe, or a read error.
+ *
+ */
+void Receiver::readLoop(){
+	std::vector<unsigned char> buf(RX_CHUNK);
+	struct pollfd pfd;
+	ssize_t n;
+
+	pfd.fd = fd_;
+	pfd.events = POLLIN;
+	while(!stop_){
+		n = poll(&pfd, 1, RX_POLL_MS);
+		if(n == 0 || (n < 0 && errno == EINTR)){
+			continue;
+		}
+		if(n < 0){
+			counters_->readErrors++;
+			break;
+		}
+		n = read(fd_, buf.data(), buf.size());
+		if(n < 0 && (errno == EINTR || errno == EAGAIN)){
+			continue;
+		}
+		if(n < 0){
+			counters_->readErrors++;
+			break;
+		}
+		if(n == 0){
+			break;								// end of file, pipe closed or hung up
+		}
+		counters_->bytes.fetch_add(n, std::memory_order_relaxed);
+		lcsFeed(&parser_, buf.data(), n, onConv, this);
+		publish();
+	}
+	publish();
+	reading_ = false;
+}
+
+
+/*
+ *  === callLoop ===
+ *
+ *  The callback thread: pops in batches, backs off from yielding to short
+ *  sleeps while the ring is empty. Ends once the reader has ended and the
+ *  ring is empty.
+ *
+ */
+void Receiver::callLoop(){
+	Sample batch[RX_BATCH];
+	unsigned spins = 0;
+	size_t n, i;
+
+	for(;;){
+		n = ring_.pop(batch, RX_BATCH);
+		for(i=0; i<n; i++)(callback_(batch[i]));
+		if(n){
+			spins = 0;
+			continue;
+		}
+		if(!reading_ && ring_.size() == 0){
+			break;
+		}
+		if(++spins < 64){
+			std::this_thread::yield();
+		}
+		else{
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+}
+
+}
@@ -0,0 +1,126 @@
+/*
+ * lcsRx.h - Receiver for the sampler, in a thread of its own
+ *
+ * Opens the serial device (or a pty, pipe or capture file) and reads it in
+ * a dedicated thread, which parses ASCII and binary frames with lcsFrame
+ * and queues one packed lcs::Sample per load conversion in a lock-free
+ * single producer, single consumer ring (lcsSpsc.h). The reading never
+ * waits for the consumer: a sample that finds the ring full is dropped and
+ * counted.
+ *
+ * The ring has exactly one consumer, either
+ *
+ * 		start(callback)		a thread of the receiver calls it for each sample
+ * 		start()				the application pops, pop() / popWait()
+ *
+ * not both. stats() can be read from any thread at any time, the parse
+ * counters follow each read of the device.
+ *
+ *   lcs::Receiver rx;
+ *   if(!rx.open("/dev/ttyUSB0") || !rx.start()){		// 115200 baud, the sampler's rate after reset
+ *   	fprintf(stderr, "%s\n", rx.lastError().c_str());
+ *   	return 1;
+ *   }
+ *   rx.send("G");
+ *   lcs::Sample s[256];
+ *   size_t n = rx.popWait(s, 256, std::chrono::milliseconds(100));
+ *
+ */
+
+#ifndef LCSRX_H_
+#define LCSRX_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "lcsFrame.h"
+#include "lcsSpsc.h"
+
+namespace lcs {
+
+enum : uint8_t {
+	SAMPLE_STAMPED = 0x01,			// time is the frame's stamp, not extrapolated
+	SAMPLE_CAL = 0x02,				// loads are grams or mN, not counts
+	SAMPLE_TC = 0x04				// loads are temperature compensated
+};
+
+#pragma pack(push, 1)
+struct Sample {
+	uint64_t time;					// TA1 ticks (LCS_TICK_HZ) unwrapped, 0 if unstamped ASCII
+	int32_t load[LCS_MAX_CELLS];
+	int16_t temp;					// 0.1 C, LCS_NO_TEMP if the frame has none
+	int16_t rh;						// 0.1 %, -1 if none
+	int16_t battMv;					// -1 if none
+	uint8_t seq;
+	uint8_t type;					// LCS_T_xxx, LCS_T_ASCII
+	uint8_t src;					// HX_SRC: 0 = A128, 1 = A64, 2 = B32
+	uint8_t cells;
+	uint8_t flags;					// SAMPLE_xxx
+};
+#pragma pack(pop)
+
+struct RxStats {
+	uint64_t bytes;					// read from the device
+	uint64_t samples;				// queued
+	uint64_t dropped;				// ring full
+	uint64_t frames[5];				// good frames by type, [LCS_T_ASCII] ASCII
+	uint64_t crcErrors;				// bad binary frames
+	uint64_t asciiErrors;			// bad ASCII frames
+	uint64_t skipped;				// bytes outside frames (command replies)
+	uint64_t seqGaps;				// conversions missing from block/delta frames
+	uint64_t deltaLost;				// delta conversions lost waiting for a keyframe
+	uint64_t readErrors;
+};
+
+class Receiver {
+public:
+	typedef std::function<void(const Sample&)> Callback;
+
+	explicit Receiver(size_t ringSize = 65536);
+	~Receiver();
+
+	Receiver(const Receiver&) = delete;
+	Receiver& operator=(const Receiver&) = delete;
+
+	bool open(const std::string& path, unsigned long bps = 115200);
+	bool attach(int fd);			// already open, closed by close()
+	void close();
+
+	bool start(Callback callback = Callback());
+	void stop();					// after the callback has seen every queued sample
+	bool running() const;			// false once stopped or at the end of a file
+
+	bool send(const std::string& command);		// '\n' is appended
+
+	size_t pop(Sample* out, size_t max);
+	size_t popWait(Sample* out, size_t max, std::chrono::microseconds timeout);
+
+	RxStats stats() const;
+	const std::string& lastError() const;
+
+private:
+	struct Counters;
+
+	static void onConv(void* ctx, const lcsConv* cv);
+	void readLoop();
+	void callLoop();
+	void publish();
+
+	int fd_ = -1;
+	SpscRing<Sample> ring_;
+	lcsParser parser_;
+	Callback callback_;
+	std::thread reader_, caller_;
+	std::atomic<bool> stop_{false}, reading_{false};
+	std::unique_ptr<Counters> counters_;
+	std::string error_;
+};
+
+}
+
+#endif /* LCSRX_H_ */
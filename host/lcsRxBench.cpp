@@ -0,0 +1,324 @@
+/*
+ * lcsRxBench.cpp - Throughput benchmark of the receiver library
+ *
+ *   lcsRxBench [-m ascii|sample|block|mix] [-n frames] [-c cells] [-q ring] [-e every] [-k]
+ *
+ * A synthetic generator encodes frames like the firmware (ASCII frames as
+ * in ../main.c, sample and block frames as in ../frameFunks.h) and a
+ * thread of its own writes them into a pipe as fast as it takes them. An
+ * lcs::Receiver reads the other end and the main thread pops the samples
+ * (or, with -k, the receiver calls back for each), checking that every
+ * conversion arrives once, in order and intact. Reported:
+ *
+ * 		end to end		pipe, reader thread, ring and consumer, in MB/s and
+ * 						samples/s, and how many sampler streams at 115200
+ * 						baud that is
+ * 		parse only		the same bytes through lcsFeed in memory, no thread
+ *
+ * with the receiver's counts of frames, errors and drops. -e corrupts one
+ * byte of every n-th frame, those conversions must show up as parse errors
+ * and missing, never as wrong samples. -q sets the ring size (default
+ * 65536); a small ring with -k shows drops when the consumer falls behind.
+ * Delta frames need the encoder's state machine and are left to lcsBench
+ * with captures from ../sim.
+ *
+ *   make rxbench
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lcsRx.h"
+
+#define		TICKS_PER_CONV		3125		// 80 SPS at LCS_TICK_HZ
+#define		BLOCK_CONVS			16			// conversions per block frame
+#define		SERIAL_BPS			115200
+
+typedef std::vector<unsigned char> Bytes;
+
+
+/*
+ * ------------------------------ Generator ----------------------------
+ */
+class FrameGen {
+public:
+	explicit FrameGen(int cells) : cells_(cells) { }
+
+	// the load of cell c in conversion k, so the consumer can check it
+	static long load(unsigned long k, int c){
+		return (long)((k + 4096*c) & 0x7FFFFF) - ((c & 1) ? 0x800000 : 0);
+	}
+
+	void ascii(Bytes& out){
+		char f[16];
+		int c;
+
+		out.push_back(0);
+		for(c=0; c<cells_; c++){
+			long v = load(k_, c);
+			int i;
+			snprintf(f, sizeof(f), "%08ld,", v < 0 ? -v : v);
+			for(i=0; v < 0 && f[i+1] == '0'; i++);
+			if(v < 0)(f[i] = '-');				// "00-52000" like num2str24
+			append(out, f);
+		}
+		if(k_ % 10 == 0){
+			snprintf(f, sizeof(f), "%03d,%04d,", 456, 235);
+			append(out, f);
+		}
+		else{
+			append(out, "XXX,XXXX,");
+		}
+		append(out, "1202,");
+		if(cells_ < 4){
+			snprintf(f, sizeof(f), "%03u,", (unsigned)(k_ & 0xFF));
+			append(out, f);
+			snprintf(f, sizeof(f), "%010lu,", time());
+			append(out, f);
+		}
+		append(out, "\n\r");
+		k_++;
+	}
+
+	void sample(Bytes& out){
+		size_t at = header(out, LCS_T_SAMPLE);
+		int c;
+
+		for(c=0; c<cells_; c++)(put24(out, load(k_, c)));
+		put16(out, 456);
+		put16(out, 235);
+		put16(out, 12020);
+		out.push_back(0x01);					// FRAME_F_TH_NEW, source 0
+		stamp(out);
+		end(out, at);
+		k_++;
+	}
+
+	void block(Bytes& out){
+		size_t at = header(out, LCS_T_BLOCK);
+		int c, i;
+
+		out.push_back(blockSeq_++);
+		out.push_back(cells_);					// source 0
+		stamp(out);
+		for(i=0; i<BLOCK_CONVS; i++, k_++){
+			for(c=0; c<cells_; c++)(put24(out, load(k_, c)));
+		}
+		end(out, at);
+	}
+
+	unsigned long conversions() const { return k_; }
+
+private:
+	static void append(Bytes& out, const char* s){ out.insert(out.end(), s, s + strlen(s)); }
+	static void put16(Bytes& out, int v){ out.push_back(v >> 8); out.push_back(v); }
+	static void put24(Bytes& out, long v){ out.push_back(v >> 16); out.push_back(v >> 8); out.push_back(v); }
+
+	unsigned long time() const { return (unsigned long)(k_ * TICKS_PER_CONV) & 0xFFFFFFFFUL; }
+
+	size_t header(Bytes& out, int type){
+		out.push_back(LCS_SYNC);
+		out.push_back(type);
+		out.push_back(0);						// length, set by end()
+		return out.size() - 3;
+	}
+
+	// stamp of the first conversion of the frame
+	void stamp(Bytes& out){
+		unsigned long t = time();
+		out.push_back(k_ & 0xFF);
+		out.push_back(t >> 24);
+		out.push_back(t >> 16);
+		out.push_back(t >> 8);
+		out.push_back(t);
+	}
+
+	void end(Bytes& out, size_t at){
+		unsigned char crc = 0;
+		size_t i;
+		int b;
+
+		out[at+2] = out.size() - at - 3;
+		for(i=at+1; i<out.size(); i++){
+			crc ^= out[i];
+			for(b=0; b<8; b++)(crc = (crc & 0x80) ? (crc<<1)^0x07 : crc<<1);
+		}
+		out.push_back(crc);
+	}
+
+	int cells_;
+	unsigned long k_ = 0;
+	unsigned char blockSeq_ = 0;
+};
+
+
+/*
+ * ------------------------------ Consumer -----------------------------
+ */
+struct Check {
+	int cells;
+	long next = -1;								// expected load[0] of the next sample
+	unsigned long samples = 0, missing = 0, bad = 0;
+
+	void operator()(const lcs::Sample& s){
+		long k = s.load[0] & 0x7FFFFF;			// conversion index, mod 2^23
+		int c;
+
+		samples++;
+		if(s.cells != cells){
+			bad++;
+			return;
+		}
+		for(c=0; c<cells; c++){
+			if(s.load[c] != FrameGen::load(k, c)){
+				bad++;
+				return;
+			}
+		}
+		if(next >= 0 && k != next){
+			if(((k - next) & 0x7FFFFF) < 0x400000){
+				missing += (k - next) & 0x7FFFFF;	// lost to a corrupted frame
+			}
+			else{
+				bad++;							// went backwards
+			}
+		}
+		next = (k + 1) & 0x7FFFFF;
+	}
+};
+
+
+static double seconds(std::chrono::steady_clock::time_point t0){
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void usage(const char* name){
+	fprintf(stderr, "usage: %s [-m ascii|sample|block|mix] [-n frames] [-c cells] [-q ring] [-e every] [-k]\n", name);
+	exit(2);
+}
+
+int main(int argc, char** argv){
+	std::string mode = "block";
+	unsigned long frames = 0, corrupt = 0, i, ring = 65536;
+	int cells = 1, opt, fds[2], useCallback = 0;
+
+	while((opt = getopt(argc, argv, "m:n:c:q:e:k")) != -1){
+		switch(opt){
+		case 'm': mode = optarg; break;
+		case 'n': frames = strtoul(optarg, 0, 10); break;
+		case 'c': cells = atoi(optarg); break;
+		case 'q': ring = strtoul(optarg, 0, 10); break;
+		case 'e': corrupt = strtoul(optarg, 0, 10); break;
+		case 'k': useCallback = 1; break;
+		default: usage(argv[0]);
+		}
+	}
+	if(cells < 1 || cells > LCS_MAX_CELLS || ring < 2 ||
+			(mode != "ascii" && mode != "sample" && mode != "block" && mode != "mix")){
+		usage(argv[0]);
+	}
+	if(!frames)(frames = (mode == "block") ? 200000 : 2000000);
+
+	// the stream, generated up front so its cost is not measured
+	FrameGen gen(cells);
+	Bytes stream;
+	size_t at;
+	for(i=0; i<frames; i++){
+		at = stream.size();
+		if(mode == "ascii" || (mode == "mix" && i % 3 == 0)){
+			gen.ascii(stream);
+		}
+		else if(mode == "sample" || (mode == "mix" && i % 3 == 1)){
+			gen.sample(stream);
+		}
+		else{
+			gen.block(stream);
+		}
+		if(corrupt && i % corrupt == corrupt-1)(stream[at + (stream.size() - at) / 2] ^= 0x10);
+	}
+	printf("%s frames, %d cell(s): %lu frames, %lu conversions, %.1f MB\n",
+			mode.c_str(), cells, frames, gen.conversions(), stream.size() / 1e6);
+
+	// end to end
+	if(pipe(fds) < 0){
+		perror("pipe");
+		return 1;
+	}
+#ifdef F_SETPIPE_SZ
+	fcntl(fds[1], F_SETPIPE_SZ, 1 << 20);
+#endif
+	lcs::Receiver rx(ring);
+	Check check;
+	check.cells = cells;
+	rx.attach(fds[0]);
+
+	auto t0 = std::chrono::steady_clock::now();
+	if(useCallback){
+		rx.start([&check](const lcs::Sample& s){ check(s); });
+	}
+	else{
+		rx.start();
+	}
+	std::thread writer([&stream, &fds](){
+		size_t done = 0;
+		ssize_t n;
+		while(done < stream.size()){
+			n = write(fds[1], &stream[done], std::min<size_t>(65536, stream.size() - done));
+			if(n <= 0){
+				break;
+			}
+			done += n;
+		}
+		close(fds[1]);							// the reader sees the end
+	});
+	if(useCallback){
+		while(rx.running())(std::this_thread::sleep_for(std::chrono::milliseconds(1)));
+		rx.stop();								// after the last callback
+	}
+	else{
+		std::vector<lcs::Sample> batch(1024);
+		size_t n;
+		while((n = rx.popWait(batch.data(), batch.size(), std::chrono::milliseconds(100))) > 0 || rx.running()){
+			for(i=0; i<n; i++)(check(batch[i]));
+		}
+	}
+	double t = seconds(t0);
+	writer.join();
+
+	lcs::RxStats st = rx.stats();
+	double serialBps = SERIAL_BPS / 10.0;		// bytes/s, start and stop bits
+	printf("end to end (%s):  %6.3f s, %7.1f MB/s, %6.2f M samples/s, %6.0f streams at %d baud\n",
+			useCallback ? "callback" : "pull", t, st.bytes / t / 1e6, check.samples / t / 1e6,
+			st.bytes / t / serialBps, SERIAL_BPS);
+	printf("  frames %llu ascii, %llu sample, %llu block; %llu crc errors, %llu bad ascii, %llu bytes skipped\n",
+			(unsigned long long)st.frames[LCS_T_ASCII], (unsigned long long)st.frames[LCS_T_SAMPLE],
+			(unsigned long long)st.frames[LCS_T_BLOCK], (unsigned long long)st.crcErrors,
+			(unsigned long long)st.asciiErrors, (unsigned long long)st.skipped);
+	printf("  samples %llu queued, %llu dropped (ring of %lu); consumer got %lu, %lu missing, %lu wrong\n",
+			(unsigned long long)st.samples, (unsigned long long)st.dropped, ring,
+			check.samples, check.missing, check.bad);
+
+	// parse only
+	lcsParser p;
+	unsigned long convs = 0;
+	lcsInit(&p);
+	t0 = std::chrono::steady_clock::now();
+	for(at=0; at<stream.size(); at+=65536){
+		lcsFeed(&p, &stream[at], std::min<size_t>(65536, stream.size() - at),
+				[](void* ctx, const lcsConv*){ (*(unsigned long*)ctx)++; }, &convs);
+	}
+	t = seconds(t0);
+	printf("parse only:            %6.3f s, %7.1f MB/s, %6.2f M samples/s\n",
+			t, stream.size() / t / 1e6, convs / t / 1e6);
+
+	return (check.bad || (!corrupt && (check.missing || st.dropped))) ? 1 : 0;
+}
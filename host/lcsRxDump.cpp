@@ -0,0 +1,94 @@
+/*
+ * lcsRxDump.cpp - Print the load conversions of a live sampler
+ *
+ *   lcsRxDump [-b bps] [-s seconds] device [command...]
+ *
+ * Opens the device with lcs::Receiver (lcsRx.h) at -b bps (default 115200,
+ * the sampler's rate after reset), sends the commands 100 ms apart (e.g.
+ * "B1" "G") and prints every conversion in the format of lcsDecode, with
+ * the frame type letter a(scii), s(ample), b(lock), e(vent) or d(elta),
+ * until -s seconds have passed, the device goes away or Ctrl-C. The
+ * receiver's counts go to stderr. With the simulator:
+ *
+ *   ../sim/loadCellSim &        (prints "sim: UART on /dev/pts/N")
+ *   ./lcsRxDump -s 5 /dev/pts/N B1 G
+ *
+ */
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+
+#include "lcsRx.h"
+
+static volatile sig_atomic_t quit = 0;
+
+static void onSignal(int){
+	quit = 1;
+}
+
+int main(int argc, char** argv){
+	unsigned long bps = 115200;						// as the sampler starts (uart_init(8))
+	double secs = 0;
+	int opt, i, c;
+	size_t n, k;
+
+	while((opt = getopt(argc, argv, "b:s:")) != -1){
+		if(opt == 'b'){
+			bps = strtoul(optarg, 0, 10);
+		}
+		else if(opt == 's'){
+			secs = atof(optarg);
+		}
+		else{
+			fprintf(stderr, "usage: %s [-b bps] [-s seconds] device [command...]\n", argv[0]);
+			return 2;
+		}
+	}
+	if(optind >= argc){
+		fprintf(stderr, "usage: %s [-b bps] [-s seconds] device [command...]\n", argv[0]);
+		return 2;
+	}
+
+	lcs::Receiver rx;
+	if(!rx.open(argv[optind], bps) || !rx.start()){
+		fprintf(stderr, "%s\n", rx.lastError().c_str());
+		return 1;
+	}
+	signal(SIGINT, onSignal);
+	for(i=optind+1; i<argc; i++){
+		if(!rx.send(argv[i])){
+			fprintf(stderr, "%s\n", rx.lastError().c_str());
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(secs);
+	lcs::Sample s[256];
+	while(!quit && (secs == 0 || std::chrono::steady_clock::now() < end)){
+		n = rx.popWait(s, 256, std::chrono::milliseconds(100));
+		if(n == 0 && !rx.running()){
+			break;
+		}
+		for(k=0; k<n; k++){
+			printf("%c,%d,%d,%s%.6f", "asbed"[s[k].type], s[k].src, s[k].seq,
+					(s[k].flags & lcs::SAMPLE_STAMPED) ? "" : "~", (double)s[k].time / LCS_TICK_HZ);
+			for(c=0; c<s[k].cells; c++)(printf(",%ld", (long)s[k].load[c]));
+			printf("\n");
+		}
+	}
+	rx.stop();
+
+	lcs::RxStats st = rx.stats();
+	fprintf(stderr, "%llu bytes; frames %llu ascii, %llu sample, %llu block, %llu event, %llu delta\n",
+			(unsigned long long)st.bytes, (unsigned long long)st.frames[LCS_T_ASCII],
+			(unsigned long long)st.frames[LCS_T_SAMPLE], (unsigned long long)st.frames[LCS_T_BLOCK],
+			(unsigned long long)st.frames[LCS_T_EVENT], (unsigned long long)st.frames[LCS_T_DELTA]);
+	fprintf(stderr, "%llu crc errors, %llu bad ascii, %llu bytes skipped, %llu samples, %llu dropped, %llu read errors\n",
+			(unsigned long long)st.crcErrors, (unsigned long long)st.asciiErrors, (unsigned long long)st.skipped,
+			(unsigned long long)st.samples, (unsigned long long)st.dropped, (unsigned long long)st.readErrors);
+	return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * lcsSpsc.h - Lock-free single producer, single consumer ring
+ *
+ * One thread pushes, one other thread pops, neither ever blocks or takes a
+ * lock. The capacity is rounded up to a power of two. head and tail count
+ * up forever (size_t), their difference is the fill; each side keeps a
+ * cached copy of the other side's index so it only touches the shared
+ * cache line when the cached one says full (or empty).
+ *
+ */
+
+#ifndef LCSSPSC_H_
+#define LCSSPSC_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace lcs {
+
+template<typename T>
+class SpscRing {
+public:
+	explicit SpscRing(size_t capacity){
+		size_t n = 2;
+		while(n < capacity)(n <<= 1);
+		buf_.resize(n);
+		mask_ = n - 1;
+	}
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	// producer: false if full, the item is not queued
+	bool push(const T& item){
+		size_t h = head_.load(std::memory_order_relaxed);
+
+		if(h - tailCache_ > mask_){
+			tailCache_ = tail_.load(std::memory_order_acquire);
+			if(h - tailCache_ > mask_){
+				return false;
+			}
+		}
+		buf_[h & mask_] = item;
+		head_.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer: false if empty
+	bool pop(T& item){
+		return pop(&item, 1) == 1;
+	}
+
+	// consumer: up to max items, returns how many
+	size_t pop(T* out, size_t max){
+		size_t t = tail_.load(std::memory_order_relaxed), n, i;
+
+		if(headCache_ == t){
+			headCache_ = head_.load(std::memory_order_acquire);
+		}
+		n = headCache_ - t;
+		if(n > max)(n = max);
+		for(i=0; i<n; i++)(out[i] = buf_[(t + i) & mask_]);
+		if(n)(tail_.store(t + n, std::memory_order_release));
+		return n;
+	}
+
+	// either side, a snapshot
+	size_t size() const {
+		return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+	}
+
+	size_t capacity() const {
+		return mask_ + 1;
+	}
+
+private:
+	std::vector<T> buf_;
+	size_t mask_;
+	alignas(64) std::atomic<size_t> head_{0};		// next slot to write, producer
+	size_t tailCache_ = 0;							// producer's copy of tail_
+	alignas(64) std::atomic<size_t> tail_{0};		// next slot to read, consumer
+	size_t headCache_ = 0;							// consumer's copy of head_
+};
+
+}
+
+#endif /* LCSSPSC_H_ */
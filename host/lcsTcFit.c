@@ -0,0 +1,250 @@
+/*
+ * lcsTcFit.c - Fit a temperature compensation table from a soak capture
+ *
+ *   lcsTcFit [-g t0,step] [-r tref] [capture]      (stdin if omitted)
+ *
+ * Record binary frames (B001) with the rig unloaded while the temperature
+ * moves slowly over the range it will see, with no table loaded (t000) and
+ * in counts (N000). The loads of the most common source are fit per cell
+ * against the temperature of the frames with the firmware's model (see
+ * ../tcFunks.h): TC_N points step apart, linear in between and held
+ * outside. A small penalty on the second differences keeps points with
+ * little data in line with their neighbours.
+ *
+ * The table is made relative to the load at tref (0.1 C, default the mean
+ * temperature of the capture), so a tare taken near tref stays good. The
+ * grid is t0,step in 0.1 C, by default spread over the temperature range
+ * of the capture. The commands to load the table go to stdout, e.g.
+ *
+ *   t200,50
+ *   t0,0,-1250
+ *   ...
+ *   t1
+ *
+ * to be sent one at a time, waiting for each answer, from the source
+ * that was first in the C list of the capture. The fit, with the spread of
+ * each cell's load before and after compensation, goes to stderr.
+ *
+ * E.g. with the simulator, a drift from 5 to 45 C over 10 minutes (SIM_PLANT
+ * only to hold the rig unloaded):
+ *
+ *   SIM_QUIET=1 SIM_SECONDS=600 SIM_TEMP=5,45 SIM_PLANT=1000000 SIM_INPUT='B1\nD16\nG\n' \
+ *       SIM_TXLOG=soak.bin ../sim/loadCellSim
+ *   ./lcsTcFit soak.bin
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "lcsFrame.h"
+
+#define		TC_N			7			// points per cell, as ../tcFunks.h
+#define		TC_STEP_MAX		5000
+#define		SMOOTH			0.01		// second difference penalty per sample
+
+typedef struct {
+	int src, temp;
+	long load[LCS_MAX_CELLS];
+} soakSample;
+
+static soakSample* samples = 0;
+static int count = 0, room = 0, cells = 0;
+static unsigned long skipped = 0;
+
+
+static void collect(void* ctx, const lcsConv* cv){
+	if(cv->type != LCS_T_SAMPLE || cv->cal || cv->tc || cv->temp == LCS_NO_TEMP ||
+			(cells && cv->cells != cells)){
+		skipped++;
+		return;
+	}
+	if(count == room){
+		room = room ? 2*room : 1024;
+		if(!(samples = realloc(samples, room * sizeof(soakSample)))){
+			perror("lcsTcFit");
+			exit(1);
+		}
+	}
+	cells = cv->cells;
+	samples[count].src = cv->src;
+	samples[count].temp = cv->temp;
+	memcpy(samples[count].load, cv->load, sizeof(cv->load));
+	count++;
+}
+
+// hat basis weights of the table points at temperature t
+static void weights(double t, int t0, int step, double* w){
+	double x = (t - t0) / step;
+	int i;
+
+	memset(w, 0, TC_N * sizeof(double));
+	if(x <= 0){
+		w[0] = 1;
+	}
+	else if(x >= TC_N-1){
+		w[TC_N-1] = 1;
+	}
+	else{
+		i = (int)x;
+		w[i] = i + 1 - x;
+		w[i+1] = x - i;
+	}
+}
+
+// solves a x = b by elimination with partial pivoting, returns 1 if singular
+static int solve(double a[TC_N][TC_N], double* b, double* x){
+	int i, j, k, m;
+	double f, t;
+
+	for(i=0; i<TC_N; i++){
+		for(m=i, j=i+1; j<TC_N; j++){
+			if(fabs(a[j][i]) > fabs(a[m][i]))(m = j);
+		}
+		if(fabs(a[m][i]) < 1e-9){
+			return 1;
+		}
+		for(k=0; k<TC_N; k++){
+			t = a[i][k]; a[i][k] = a[m][k]; a[m][k] = t;
+		}
+		t = b[i]; b[i] = b[m]; b[m] = t;
+		for(j=i+1; j<TC_N; j++){
+			f = a[j][i] / a[i][i];
+			for(k=i; k<TC_N; k++)(a[j][k] -= f * a[i][k]);
+			b[j] -= f * b[i];
+		}
+	}
+	for(i=TC_N-1; i>=0; i--){
+		for(t=b[i], k=i+1; k<TC_N; k++)(t -= a[i][k] * x[k]);
+		x[i] = t / a[i][i];
+	}
+	return 0;
+}
+
+static void usage(const char* name){
+	fprintf(stderr, "usage: %s [-g t0,step] [-r tref] [capture]\n", name);
+	exit(2);
+}
+
+int main(int argc, char** argv){
+	FILE* in = stdin;
+	unsigned char buf[512];
+	lcsParser p;
+	size_t n;
+	int opt, k, c, i, j, src, used = 0, t0 = 0, step = 0, tmin = 0, tmax = 0, hasRef = 0, clamped = 0;
+	unsigned long bySrc[4] = {0};
+	double tref = 0, a[TC_N][TC_N], b[TC_N], x[TC_N], w[TC_N], corr[LCS_MAX_CELLS][TC_N];
+
+	while((opt = getopt(argc, argv, "g:r:")) != -1){
+		if(opt == 'g'){
+			if(sscanf(optarg, "%d,%d", &t0, &step) != 2 || step < 1 || step > TC_STEP_MAX)(usage(argv[0]));
+		}
+		else if(opt == 'r'){
+			tref = atof(optarg);
+			hasRef = 1;
+		}
+		else{
+			usage(argv[0]);
+		}
+	}
+	if(optind < argc && !(in = fopen(argv[optind], "rb"))){
+		perror(argv[optind]);
+		return 1;
+	}
+
+	lcsInit(&p);
+	while((n = fread(buf, 1, sizeof(buf), in)) > 0){
+		lcsFeed(&p, buf, n, collect, 0);
+	}
+
+	// the most common source, its temperature range
+	for(k=0; k<count; k++)(bySrc[samples[k].src]++);
+	for(src=0, i=1; i<4; i++){
+		if(bySrc[i] > bySrc[src])(src = i);
+	}
+	for(k=0; k<count; k++){
+		if(samples[k].src != src){
+			continue;
+		}
+		if(!used || samples[k].temp < tmin)(tmin = samples[k].temp);
+		if(!used || samples[k].temp > tmax)(tmax = samples[k].temp);
+		if(!hasRef)(tref += samples[k].temp);
+		samples[used++] = samples[k];
+	}
+	if(used < 2*TC_N || tmax == tmin){
+		fprintf(stderr, "%d raw sample frames with a temperature, need %d over a temperature range\n",
+				used, 2*TC_N);
+		return 1;
+	}
+	if(!hasRef)(tref /= used);
+	if(!step){
+		step = (tmax - tmin + TC_N-2) / (TC_N-1);
+		if(step > TC_STEP_MAX)(step = TC_STEP_MAX);
+		t0 = tmin;
+	}
+	fprintf(stderr, "%d samples of source %d, %lu frames skipped, %.1f to %.1f C, points at %.1f C + n * %.1f C\n",
+			used, src, skipped, tmin/10.0, tmax/10.0, t0/10.0, step/10.0);
+
+	for(c=0; c<cells; c++){
+		double sum = 0, ref, mean, sq = 0, comp = 0, compSq = 0, y;
+
+		// normal equations of the least squares fit, plus the smoothing
+		memset(a, 0, sizeof(a));
+		memset(b, 0, sizeof(b));
+		for(k=0; k<used; k++){
+			weights(samples[k].temp, t0, step, w);
+			for(i=0; i<TC_N; i++){
+				for(j=0; j<TC_N; j++)(a[i][j] += w[i] * w[j]);
+				b[i] += w[i] * samples[k].load[c];
+			}
+			sum += samples[k].load[c];
+		}
+		for(i=1; i<TC_N-1; i++){
+			double d[3] = {1, -2, 1};
+			for(j=0; j<3; j++){
+				for(k=0; k<3; k++)(a[i-1+j][i-1+k] += SMOOTH * used * d[j] * d[k]);
+			}
+		}
+		if(solve(a, b, x)){
+			fprintf(stderr, "cell %d: the temperatures do not cover the grid, try -g\n", c);
+			return 1;
+		}
+
+		// relative to tref
+		weights(tref, t0, step, w);
+		for(ref=0, i=0; i<TC_N; i++)(ref += w[i] * x[i]);
+		for(i=0; i<TC_N; i++){
+			corr[c][i] = floor(x[i] - ref + 0.5);
+			if(fabs(corr[c][i]) > 32767){
+				corr[c][i] = (corr[c][i] < 0) ? -32767 : 32767;
+				clamped = 1;
+			}
+		}
+
+		// spread before and after
+		mean = sum / used;
+		for(k=0; k<used; k++){
+			weights(samples[k].temp, t0, step, w);
+			for(y=samples[k].load[c], i=0; i<TC_N; i++)(y -= w[i] * corr[c][i]);
+			sq += (samples[k].load[c] - mean) * (samples[k].load[c] - mean);
+			comp += y;
+			compSq += y * y;
+		}
+		comp /= used;
+		fprintf(stderr, "cell %d: rms %.0f counts, %.0f compensated, %.0f to %.0f counts over the range\n",
+				c, sqrt(sq / used), sqrt(compSq / used - comp * comp), corr[c][0], corr[c][TC_N-1]);
+	}
+	if(clamped){
+		fprintf(stderr, "some points are out of range and were clamped to +-32767 counts\n");
+	}
+
+	printf("t%d,%d\n", t0, step);
+	for(c=0; c<cells; c++){
+		for(i=0; i<TC_N; i++)(printf("t%d,%d,%.0f\n", c, i, corr[c][i]));
+	}
+	printf("t1\n");
+	return 0;
+}
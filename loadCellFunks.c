@@ -5,51 +5,216 @@
  *      Author: bhunt
  */
 #include "loadCellFunks.h"
+#include "events.h"
+#include "tickFunks.h"
+
+unsigned char hxSched[HX_SCHED_MAX] = {HI_GAIN}, hxSlots = 1;	// extra clocks after each read, see loadCellFunks.h
+unsigned int hxDropped = 0;				// conversions lost to a full queue
+
+long int hxQueue[HX_QUEUE_LENG][HX_CELLS];
+unsigned long hxQueueTime[HX_QUEUE_LENG];
+unsigned char hxQueueSrc[HX_QUEUE_LENG], hxQueueSeq[HX_QUEUE_LENG];
+unsigned long hxTime;					// stamp of the conversion last returned by hxPop
+unsigned char hxSeq, hxCount = 0;		// hxCount: conversions read, queued or dropped
+volatile unsigned char hxHead = 0, hxTail = 0;
+unsigned char hxSlot = 0, hxCur = HI_GAIN, hxSettle = 0;		// hxCur: setting of the conversion in progress
 
 // Initialize pins
 void loadCellInit(){
 	P1DIR |= CLK;		// set CLK as output
 	P1OUT &= ~CLK;		// set CLK low
 	P1DIR &= ~SDI;		// set SDI as input
+
+	P2DIR &= ~HX_P2_PINS;
+
+	// HX711 pulls DOUT low when a conversion is ready
+	P1IES |= SDI;		// hi/lo edge
+	P2IES |= HX_P2_PINS;
+	P1IE &= ~SDI;		// enabled by hxStart()
+	P2IE &= ~HX_P2_PINS;
+}
+
+// Read every conversion from now on
+void hxStart(){
+	hxSlot = 0;
+	hxSettle = HX_SETTLE+1;		// chip may still be set up from before the stop
+	P1IFG &= ~SDI;
+	P2IFG &= ~HX_P2_PINS;
+	P1IE |= SDI;
+	P2IE |= HX_P2_PINS;
+	if(!(P1IN & SDI)){
+		P1IFG |= SDI;	// already ready, no edge will come
+	}
 }
 
+void hxStop(){
+	P1IE &= ~SDI;
+	P2IE &= ~HX_P2_PINS;
+}
 
 
-// read data from HX711 chip
-long int readData(int gain){
-	long int data = 0;
-	unsigned char i;
 
-	// check if ready, trap if not
-	while(P1IN&SDI);
-	HOLD;
+/*
+ *  === readCells ===
+ *
+ *  Reads all HX_CELLS chips at once. Each bit is one clock pulse and one
+ *  snapshot of the DOUT pins, packed so cell n is bit n (P1.5 is moved to
+ *  bit 0, P2.1-P2.3 already are bits 1-3), which is shifted into every
+ *  cell while CLK is low. Only the high time is limited (power down after
+ *  60 us), so more cells only make the low time longer. No snapshot buffer
+ *  is kept, this runs on the interrupt stack. All cells must be ready
+ *  (DOUT low) when this is called.
+ *
+ *  Call with interrupts disabled. They are enabled only while CLK is low,
+ *  so a nested ISR can stretch the low time but never the high time.
+ *
+ */
+void readCells(int gain, long int* data){
+	unsigned char i, c, snap;
 
-	// begin reading data
+	for(c=0; c<HX_CELLS; c++){
+		data[c] = 0;
+	}
 	for(i=0; i<24; i++){			// for 24 bits...
 		P1OUT |= CLK;				// toggle clock
-		data <<= 1;					// bitshift data var
 		HOLD;						// wait
 
 		P1OUT &= ~CLK;				// toggle clock
-		if(P1IN & SDI)(data++);		// set last bit
+		__enable_interrupt();		// others may nest while CLK is low
+		snap = (P2IN & HX_P2_PINS) | ((P1IN & SDI) ? 1 : 0);
+		for(c=0; c<HX_CELLS; c++){	// MSB first
+			data[c] <<= 1;
+			if(snap & (1<<c))(data[c]++);
+		}
 		HOLD;						// wait
+		__disable_interrupt();
 	}
 
-	// extra clock ticks set gain of chip
+	// extra clock ticks set gain of chips
 	for(i=0; i<gain-24; i++){		// for (extra clock cycles)...
 		P1OUT |= CLK;				// toggle clock
 		HOLD;						// wait
 		P1OUT &= ~CLK;				// toggle clock
+		__enable_interrupt();
 		HOLD;						// wait
+		__disable_interrupt();
+	}
+}
+
+
+/*
+ *  === hxIsr ===
+ *
+ *  Called from the port 1 and port 2 ISRs on a DOUT falling edge. Once
+ *  every cell is ready, stamps the conversions (tickNow and the next
+ *  sequence number), clocks them out and posts them to the sample queue.
+ *  They are read straight into the free slot at hxHead, which the mainloop
+ *  does not touch, and only published if the queue has room.
+ *  Other interrupts may nest while CLK is low (see readCells) so the UART
+ *  is not starved. CLK high is never stretched: at 1 MHz a nested ISR takes
+ *  longer than the 60 us after which the HX711 powers down.
+ *
+ */
+void hxIsr(void){
+	unsigned char next, src, gain, valid = 1;
+
+	P1IFG &= ~SDI;
+	P2IFG &= ~HX_P2_PINS;
+	if((P1IN & SDI) || (P2IN & HX_P2_PINS)){
+		return;						// wait for the edge of the last cell
 	}
+	hxQueueTime[hxHead] = tickNow();	// the free slot, like the loads
 
-	if(data&(0x08000000)){			// if 24th bit is 1 (num is neg)...
-		data = ~data;				// invert numbers
-		data++;						// add one (two's comp)
+	// pick the setting of the next conversion
+	if(hxSettle){
+		hxSettle--;
+		valid = 0;					// this one is not settled yet
 	}
+	else{
+		hxSlot = (hxSlot+1 < hxSlots) ? hxSlot+1 : 0;
+		if(hxSched[hxSlot] != hxCur)(hxSettle = HX_SETTLE);
+	}
+	gain = hxSched[hxSlot];
+	src = HX_SRC(hxCur);
+	hxCur = gain;
+
+	P1IE &= ~SDI;					// DOUT toggles while clocking
+	P2IE &= ~HX_P2_PINS;
+	readCells(gain, hxQueue[hxHead]);		// nests in the low phases
+	P1IFG &= ~SDI;
+	P2IFG &= ~HX_P2_PINS;
+	P1IE |= SDI;
+	P2IE |= HX_P2_PINS;
+
+	if(!valid){
+		return;
+	}
+	hxCount++;
+	next = (hxHead+1) & (HX_QUEUE_LENG-1);
+	if(next == hxTail){
+		hxDropped++;				// main loop is behind, drop newest
+		return;
+	}
+	hxQueueSrc[hxHead] = src;
+	hxQueueSeq[hxHead] = hxCount;
+	hxHead = next;
+	events |= EV_HX;
+}
+
+
+/*
+ *  === hxPop ===
+ *
+ *  Copies the oldest queued conversion of each cell to sample[], sign
+ *  extended so the cells can be added and subtracted, and its source
+ *  (HX_SRC) to *src, its stamp to hxTime and hxSeq. Returns 0 if the queue
+ *  is empty.
+ *
+ */
+int hxPop(long int* sample, unsigned char* src){
+	unsigned char c;
 
-	return data;
+	if(hxTail == hxHead){
+		return 0;
+	}
+	for(c=0; c<HX_CELLS; c++){
+		sample[c] = hxSigned(hxQueue[hxTail][c]);
+	}
+	*src = hxQueueSrc[hxTail];
+	hxSeq = hxQueueSeq[hxTail];
+	hxTime = hxQueueTime[hxTail];
+	hxTail = (hxTail+1) & (HX_QUEUE_LENG-1);
+	return 1;
 }
 
 
+/*
+ *  === hxSchedule ===
+ *
+ *  Sets the list of gain settings (HI_GAIN, MED_GAIN, LO_GAIN) the reads
+ *  cycle through. Returns 1 (nothing changed) if n or a setting is invalid.
+ *  The conversion in progress and the next HX_SETTLE are discarded.
+ *
+ */
+int hxSchedule(unsigned char* gains, unsigned char n){
+	unsigned char i;
+
+	if(n < 1 || n > HX_SCHED_MAX){
+		return 1;
+	}
+	for(i=0; i<n; i++){
+		if(gains[i] != HI_GAIN && gains[i] != MED_GAIN && gains[i] != LO_GAIN){
+			return 1;
+		}
+	}
 
+	__disable_interrupt();
+	for(i=0; i<n; i++){
+		hxSched[i] = gains[i];
+	}
+	hxSlots = n;
+	hxSlot = 0;
+	hxSettle = HX_SETTLE+1;
+	__enable_interrupt();
+	return 0;
+}
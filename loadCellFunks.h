@@ -3,8 +3,27 @@
  *
  *  Created on: May 20, 2019
  *      Author: bhunt
+ *
+ * Up to four HX711s can share CLK (P1.4). Cell 0 is on SDI (P1.5), cell
+ * n = 1-3 has its DOUT on P2.n. Set HX_CELLS at build time (-DHX_CELLS=3);
+ * RAM for the sample queue, the filter and the frames grows with it: one
+ * cell fits the G2553's 512 bytes with the stack, more need a part with
+ * more RAM (make ramcheck in bench/ adds it up).
+ *
+ * The gain pulses after each read select channel and gain of the next
+ * conversion. hxSchedule() sets a list of up to HX_SCHED_MAX settings that
+ * the reads cycle through, one conversion each. After every change of
+ * setting the HX711 needs four conversion periods to settle (datasheet,
+ * 50 ms at 80 SPS), so the first HX_SETTLE conversions are discarded.
+ * Repeating an entry ("C128,128,032": A128 twice, then B32) weights it
+ * without extra settling.
+ * Every queued sample is tagged with its source, HX_SRC(gain), and
+ * stamped with the tick count (tickFunks.h) when it was read and a
+ * sequence number that counts every conversion read, so a gap shows the
+ * conversions dropped on the way to the computer.
  */
-#include <msp430.h>
+#include "hal.h"
+#include "clock.h"
 
 #ifndef LOADCELLFUNKS_H_
 #define LOADCELLFUNKS_H_
@@ -13,15 +32,44 @@
 // Various defines
 #define 	SDI			0x20
 #define 	CLK 		0x10
-#define 	HOLD		__delay_cycles(8)
+#define		HX_HOLD_US	1		// PD_SCK high/low time, 0.2 - 50 us (power down after 60 us)
+#define 	HOLD		__delay_cycles(CYCLES_US(HX_HOLD_US))
 #define		HI_GAIN		25
 #define		MED_GAIN	27
 #define		LO_GAIN		26
+#define		HX_SRC(g)	((g) == HI_GAIN ? 0 : (g) == MED_GAIN ? 1 : 2)	// A128, A64, B32
+#define		HX_SRCS		3
+#define		HX_SCHED_MAX	4
+#define		HX_SPS		80		// conversion rate, RATE pin high
+#define		HX_SETTLE	3		// conversions discarded after a change of setting
+#ifndef HX_CELLS
+#define		HX_CELLS	1		// HX711s on the shared clock, 1-4
+#endif
+#define		HX_P2_PINS	(((1<<HX_CELLS)-1) & 0x0E)	// DOUTs of cells 1-3
+#define		HX_QUEUE_LENG	4		// sample queue length, must be a power of two
+
 
+extern unsigned char hxSched[HX_SCHED_MAX], hxSlots;
+extern unsigned int hxDropped;
+extern unsigned long hxTime;
+extern unsigned char hxSeq;
+
+// sign extends a 24-bit two's complement conversion (bit 23) to a long
+static inline long int hxSigned(long int x){
+	return ((x & 0x00FFFFFF) ^ 0x00800000) - 0x00800000;
+}
 
 // Functions
 void loadCellInit();
-long int readData(int);
+void hxStart();
+void hxStop();
+void readCells(int, long int*);
+void hxIsr(void);
+int hxPop(long int*, unsigned char*);
+int hxSchedule(unsigned char*, unsigned char);
+
+
+CLK_ASSERT(CYCLES_US(HX_HOLD_US) >= 1 && HX_HOLD_US <= 40, hx_sck_timing);
 
 
 #endif /* LOADCELLFUNKS_H_ */
@@ -19,6 +19,11 @@
  * P1.7	-->	Temp/Humidity sensor
  *
  *
+ * Commands are a letter followed by a decimal argument and end with \n,
+ * \r or ';', e.g. "F053\n" or "F53;R20;S0\n". They are buffered by the
+ * UART receive interrupt and handled in the mainloop, so they may be sent
+ * back to back.
+ *
  * Frame sent to MatLab has the structure:
  *
  * 		12345678,12,123,123,\r\n
@@ -28,23 +33,171 @@
  *	  Load     Temp    Humidity	 Voltage
  *
  * Where the first eight characters represent a signed value from the
- * load cell, the next two are temperature in C, and the last three
- * are relative humidity*10, i.e. a value of 273 = 27.3% humidity
+ * load cell (one such field per cell if built with HX_CELLS > 1), the
+ * next two are temperature in C, and the last three are relative
+ * humidity*10, i.e. a value of 273 = 27.3% humidity
+ *
+ * Two more fields follow the voltage, "123,1234567890,": the sequence
+ * number (000-255) and the 32-bit TA1 tick count of the last conversion in
+ * the load, see frameFunks.h. They do not fit an ASCII frame with
+ * HX_CELLS = 4 and are left out there.
+ *
+ * The 'B' command switches to a binary frame (see frameFunks.h), about
+ * half the size of the ASCII one: 19 bytes against 41 with one cell.
+ *
+ * 		B000	ASCII frame (default, above)
+ * 		B001	binary frame
+ * 		B002	burst: binary frames, plus every raw conversion in block
+ * 				frames (FRAME_T_BLOCK, see burstFunks.h)
+ * 		B003	delta: binary frames, plus every raw conversion compressed
+ * 				in delta frames (FRAME_T_DELTA, see deltaFunks.h)
+ *
+ * The load value is the output of the decimation filter (filtFunks.h),
+ * which runs on every HX711 conversion:
+ *
+ * 		D###	decimation rate, 001-064 conversions per output
+ * 		O###	filter order, 000 = average of those conversions,
+ * 				001-007 = binomial FIR over the last 2-8 averages
+ *
+ * Both answer like the acquisition parameters below and restart the filter.
+ * An order above 000 keeps its history where burst mode, delta mode and
+ * the trigger keep their conversions, so it ends those (B001, E000), and
+ * B002, B003 or arming the trigger set the order to 000.
+ *
+ * Acquisition parameters can be changed while running:
+ *
+ * 		P###	sample (frame) period in 10 ms steps, 001-255
+ * 		A###	HX711 input and gain, 128 or 064 (channel A), 032 (channel B)
+ * 		C###,###...	cycle through up to 4 of the A gains, e.g. "C128,032"
+ * 		T###	temp/humidity rest period in TA1 rollovers (~262 ms), 004-255
+ * 		U###	baud rate index, 000-008 = 300 ... 115200 (see uart_init)
+ *
+ * The trigger (burstFunks.h) records the raw conversions around a load
+ * event and sends them as event frames, so arming it selects binary frames:
+ *
+ * 		E###	000 off, 001 level, 002 slope, 003 delta; add 004 to send
+ * 				the record as soon as it is complete. Arms a new record.
+ * 		L###	threshold in steps of 256 counts, 001-999
+ * 		W###	send the record now ("W?" answers with the trigger state,
+ * 				000 off, 001 filling, 002 armed, 003 fired, 004 complete)
+ *
+ * Force control (ctrlFunks.h) drives the PWM output from the load on
+ * every conversion, without the round trip through the host:
+ *
+ * 		H###	hold the load (sum of all cells) at ### * 256 counts,
+ * 				000-999, and close the loop
+ * 		J###,###	Kp and Ki, 000-999 each, Ki in 1/256 of Kp's scale
+ * 				per conversion (ctrlFunks.h)
+ * 		M###,###,###	reverse, forward and integral limits in percent
+ *
+ * F, R, S, G and Q open the loop again.
+ *
+ * F and R can ramp the output to the new setting instead of jumping to it
+ * (profFunks.h), stepped once per PWM period by the Timer0_A0 interrupt:
+ *
+ * 		V###,###	profile shape, 000 jump (default), 001 trapezoid,
+ * 				002 S-curve, and move time in 10 ms steps, 001-999
+ * 		Y		progress of the current move, 000-100 percent (100 when
+ * 				there is none)
+ *
+ * S, G, Q and H end a move where it is.
+ *
+ * The loads can be sent in grams or millinewtons instead of counts
+ * (calFunks.h). The calibration is kept in information flash and is in
+ * effect from reset, so a rig sends calibrated frames from the first 'G':
+ *
+ * 		X		tare, the current load of each cell becomes its zero
+ * 		I####[,###]	span, #### grams (0001-9999) are on the rig now: one
+ * 				span for the sum of all cells, or for cell ### alone
+ * 		N###	unit of the loads, 000 counts (default), 001 grams,
+ * 				002 millinewtons
+ *
+ * X and I take the load of the frames from the first C entry, so they
+ * need the sampler running, and D/O to average it. X answers with the gain
+ * it was taken on ("X128"), I with the number of cells that have a span.
+ * Each of X, I and N holds the CPU for about 20 ms while it writes the
+ * flash, commands sent meanwhile are lost: wait for the answer.
+ *
+ * The zero drift of the bridges with temperature can be taken out of the
+ * loads by a table per cell over the DHT temperature (tcFunks.h), fit on
+ * the computer from a recorded soak (host/lcsTcFit prints the commands).
+ * All capital letters being taken, its command is a lower case 't':
+ *
+ * 		t####,####	new table, first point at temperature #### and the
+ * 				others #### apart (0.1 C like the frames); erases the old
+ * 				one and turns compensation off ("t-100,50")
+ * 		t#,#,####	correction of cell #, point # (0-6), in counts
+ * 		t001		finish the table, compensation is on from the next
+ * 				reading (and after every reset)
+ * 		t000		erase the table, compensation off
+ *
+ * 't?' answers with the state, 000 off, 001 loading, 002 waiting
+ * for a reading, 003 on; a new table or point with its values once they
+ * read back from flash, the state if rejected. Each takes the flash like X,
+ * wait for the answer. Compensation applies to the source that was first
+ * in the C list when the table was started and comes before the
+ * calibration, so tare again after loading a table. Binary frames carry
+ * FRAME_F_TC.
+ *
+ * Diagnostics (statFunks.h):
+ *
+ * 		K		send every error counter and worst case timing in one line,
+ * 				as soon as the TX ring has room for it
+ * 		Z		clear them
+ *
+ * Leading zeros are optional everywhere ("P10" = "P010"). Values with a
+ * ',' list may be negative and have up to five digits where the command
+ * allows it.
+ *
+ * With more than one entry in the C list each frame carries the latest
+ * conversion of the next entry, unfiltered, tagged with its gain: binary
+ * frames in the flags byte (FRAME_F_SRC), ASCII frames with an extra
+ * "128," / "064," / "032," field after the voltage. Only the source the
+ * tare was taken on is calibrated (FRAME_F_CAL in binary frames).
+ *
+ * Each of these is answered with its letter and the value now in effect,
+ * e.g. "P010\n\r" ("W" answers with the number of conversions sent). A
+ * rejected value is answered with '!' after the letter
+ * ("P!010\n\r") and leaves the setting unchanged. '?' in place of the
+ * digits ("P?") only queries. P and U are rejected if an ASCII frame
+ * would not fit in the sample period at the resulting baud rate. A new baud
+ * rate is applied after the reply has been sent.
  *
  */
 
 //includes
-#include <msp430.h>
+#include "hal.h"
 #include "loadCellFunks.h"
 #include "serial_handler.h"
 #include "thFunks.h"
+#include "frameFunks.h"
+#include "filtFunks.h"
+#include "burstFunks.h"
+#include "deltaFunks.h"
+#include "fmtFunks.h"
+#include "statFunks.h"
+#include "tickFunks.h"
+#include "ctrlFunks.h"
+#include "profFunks.h"
+#include "calFunks.h"
+#include "tcFunks.h"
+#include "events.h"
+#include "clock.h"
 
 // defines
 #define FRAME_LENGTH  22		// length of max 24-bit number reading (2^(24) = 16777216, 8 chars long)
-#define BUFF_LENG	  4		// length of received UART buffer excluding the \n terminator
-#define	FULL_STP	  375		// for 50Hz PWM
-#define FULL_FOR	  480		// ""
-#define FULL_REV 	  250		// ""
+#define LOAD_OFS	  (9*(HX_CELLS-1))	// ASCII fields after the first load move by 9 per extra cell
+#define STAMP_LENG	  (HX_CELLS < 4 ? 15 : 0)	// ASCII sequence and time fields, too long with 4 cells
+CLK_ASSERT(FRAME_LENGTH+2+LOAD_OFS <= uart_max && STAMP_LENG+4+2 <= uart_max, ascii_frame_fits);	// the loads, then the stamp, tag and \n\r
+#define PWM_HZ		  PROF_HZ		// 500, profile steps are PWM periods
+#define	FULL_STP	  TA_US(1500)	// PWM pulse width, stopped
+#define FULL_FOR	  TA_US(1920)	// full forward
+#define FULL_REV 	  TA_US(1000)	// full reverse
+#define ADC_BLOCK	  4			// battery conversions averaged per reading
+#define BATT_SCALE	  263903	// 14400 mV * 65536 / (894 * ADC_BLOCK), see ADC10_ISR
+#define TICKS_10MS	  TA_US(10000)		// TA1 ticks per sample period step
+#define MAX_TICKS	  TA_US(250000)		// longest TA1 CCR1 interval, longer periods are split
+#define TH_SPAN		  ((unsigned int)DHT_REST[TH_REST_ST] << 8)	// rest period in TA1 ticks / 256 (rollovers)
 //#define	FULL_STP	250		// for 500Hz PWM
 //#define FULL_FOR	490		// ""
 //#define FULL_REV	10		// ""
@@ -52,19 +205,42 @@
 
 
 // functions
-void num2str24(long int);
+void num2str24(long int, unsigned char);
 void th2str(volatile char*);
-void volt2str(float);
+void volt2str(unsigned int);
 long int absVal(long int);
 void pulseOut(char*);
+int pwmWidth(int);
 void pulseOutParabolic(char* cmd);
+int cmdNum(char*);
+void clockInit(void);
+void startSampling(void);
+void stopSampling(void);
+int setPeriod(int);
+int gainCode(int);
+int cmdList(char*, int*, unsigned char);
+int frameFits(int, int);
+void burstRelease(void);
+void sampleSend(void);
+void config(char*);
+void calConfig(char*);
+void cmdReply(char, int, unsigned char);
+void cmdReplyList(char, int*, unsigned char, unsigned char);
 
 // global variables
-long int data;
-unsigned char sampDataFlag = 0, thState = 0, thRefreshFlag = 0;
-char buffer[BUFF_LENG], DHT_REST[2] = {5,10}, TH_REST_ST = 0;
-int loopCounter = 0;
-float adcMem, voltage;
+long int sample[HX_CELLS], srcData[HX_SRCS][HX_CELLS];
+unsigned long srcTime[HX_SRCS];				// stamp of the load sent for each source
+unsigned char srcSeq[HX_SRCS];
+const int srcGain[HX_SRCS] = {128, 64, 32};		// by HX_SRC()
+unsigned char src, frameSlot = 0;
+volatile unsigned char sampDataFlag = 0, thState = 0, events = 0;
+unsigned char thRefreshFlag = 0, thErrorFlag = 0, running = 0;	// thErrorFlag: last thRead(), for the next frame
+unsigned char TH_REST_ST = 0;
+unsigned char DHT_REST[2] = {5,10};
+unsigned char sampPeriod = 10, sampDiv = 1, sampSub = 0;		// 10 * 10 ms, CCR1 intervals per period
+unsigned int sampTicks = 10*TICKS_10MS;
+unsigned char loopCounter = 0;		// TA1 rollovers the temp/humidity sensor has rested
+unsigned int adcBuf[ADC_BLOCK], battMv = 0;
 
 
 /*
@@ -72,13 +248,13 @@ float adcMem, voltage;
  */
 int main(void){
   WDTCTL = WDTPW + WDTHOLD;                 // Stop WDT
+  clockInit();								// MCLK_HZ, see clock.h
 
-  // TimerA0 interrupt init
-  TA0CCTL0 = CCIE;                         	// CCR0 interrupt enabled
+  // TimerA0 init, generates the PWM, CCR0 interrupt only during profile moves (profFunks.h)
 //  CCR0 = 5000;							// 50 Hz PWM
-  TA0CCR0 = 500;							// 500 Hz PWM
+  TA0CCR0 = TA_HZ/PWM_HZ;					// 500 Hz PWM
 //  CCR0 = 498;								// 500 hz pwm sync
-  TA0CTL = TASSEL_2 | MC_1 | ID_2;       	// SMCLK, upmode, divide by 8 (1MHz / 4 = 250 kHz)
+  TA0CTL = TASSEL_2 | MC_1 | TA_ID;       	// SMCLK, upmode, TA_HZ
 
   // PWM init
   P1SEL |= BIT6;                            // P1.6 for TA0.1 output
@@ -86,10 +262,9 @@ int main(void){
   TA0CCTL1 = OUTMOD_7;                      // CCR1 reset/set
   TA0CCR1 = FULL_STP;                       // CCR1 PWM duty cycle, init to STOP
 
-  // Temp/Humidity sensor initialization
+  // Temp/Humidity sensor initialization, TA1 CCR1 is the sample tick (see startSampling)
   TA1CCTL0 = CCIE;                         	// CCR0 interrupt enabled
-  TA1CTL = TASSEL_2 | MC_2 | ID_2;       	// SMCLK, contmode, divide by 8 (1MHz / 4 = 250 kHz)
-  int error;
+  TA1CTL = TASSEL_2 | MC_2 | TA_ID | TAIE;	// SMCLK, contmode, TA_HZ, overflows extend TA1R (tickFunks.h)
   thInit();
 
   // Port interrupt (DHT sample frequency selector)
@@ -100,50 +275,102 @@ int main(void){
   P1IFG &= ~BIT3;                  // P1.3 IFG cleared
 
   // ADC initialization
-  ADC10CTL0 = ADC10SHT_2 + ADC10ON + ADC10IE; // ADC10ON, interrupt enabled
-  ADC10CTL1 = INCH_3;                       // input A3
+  ADC10CTL0 = ADC10SHT_2 + MSC + ADC10ON + ADC10IE; // ADC10ON, back-to-back conversions, interrupt enabled
+  ADC10CTL1 = INCH_3 + CONSEQ_2;            // input A3, repeat single channel
+  ADC10DTC1 = ADC_BLOCK;                    // DTC moves ADC_BLOCK conversions to adcBuf
   ADC10AE0 |= 0x08;                         // PA.3 ADC option select
 
 
   // other intializations
   uart_init(8);							// initialize UART
   loadCellInit();						// initialize pins for load cell
-  int gain = HI_GAIN;					// see loadCellFunks.h for different gain levels
+  filtConfig(1,0);						// no decimation until configured
+  calInit();							// calibration from info flash, before 'G'
+  tcInit();								// and temperature compensation
   P2DIR |= BIT0;		// enable GrLED
   P2OUT &=~BIT0;
 
-  int timerCycles = 25000/CCR0;			// 0.1 sec * 125000 Hz / 511 cycles = 24.5 = 24 cycs
-
   // Flash ReLED to verify initialization
   P1DIR |= BIT0;				// enable ReLED
   P1OUT |= BIT0;
-  __delay_cycles(0xFFFF);
-  __delay_cycles(0xFFFF);
-  __delay_cycles(0xFFFF);
+  __delay_cycles(CYCLES_US(200000));
   P1OUT &= ~BIT0;
   P1DIR &= ~BIT6;				// disable PWM on startup
 
 
   th2str(thBuffer);		// init tx string
-  __bis_SR_register(CPUOFF);			// Turn off CPU, wait for start command
 //  pulseOut("F000");
 
+  // nothing runs until the start command ('G'), see startSampling
+
 
 
   while(1){
+	  unsigned char ev;
+	  unsigned int t0;
+	  char* buffer;
+
+	  // sleep in LPM0 until an interrupt posts an event
+	  __disable_interrupt();
+	  while(events == 0){
+		  __bis_SR_register(LPM0_bits + GIE);
+		  __disable_interrupt();
+	  }
+	  ev = events;
+	  events = 0;
+	  __enable_interrupt();
+	  t0 = TA1R;							// start of this pass, see statLoopMax
+
+	  // filter every conversion posted by the HX711 edge interrupt, or
+	  // keep the latest of each source if several are scheduled
+	  if(ev & EV_HX){
+		  while(hxPop(sample, &src)){
+			  if(frameMode == MODE_BURST){
+				  burstPush(sample, src);
+			  }
+			  else if(frameMode == MODE_DELTA){
+				  deltaPush(sample, src);
+			  }
+			  trigPush(sample, src);
+			  if(ctrlOn && src == HX_SRC(hxSched[0])){
+				  CCR1 = pwmWidth(ctrlStep(sample));		// force control, every conversion
+			  }
+			  if(hxSlots == 1){
+				  if(!filtPush(sample, srcData[src])){
+					  continue;
+				  }
+			  }
+			  else{
+				  unsigned char c;
+				  for(c=0; c<HX_CELLS; c++){
+					  srcData[src][c] = sample[c];
+				  }
+			  }
+			  srcTime[src] = hxTime;			// the last conversion in the load
+			  srcSeq[src] = hxSeq;
+		  }
+	  }
+	  if(ev & (EV_HX | EV_TX)){
+		  trigSend();					// rest of a record being dumped
+	  }
 
 	  // if temp/humid sensor is ready to begin
-	  if(thState == 0){
+	  if(!running || !(ev & EV_TH)){
+		  // sensor waits in state 0 or 4, restarted by 'G'
+	  }
+	  else if(thState == 0){
 		  thStart();
 		  thState = 2;		// put into "wait" state
 		  TA1CCTL0 |= CCIE;
 	  }
-	  else if(thState == 1){
-		  error = thRead();
+	  else if(thState == 4){			// transfer finished (or timed out)
+		  int t = thTemp();
+		  thErrorFlag = thRead();
 		  thRefreshFlag = 1;
+		  if(!thErrorFlag)(tcReading(t, srcTime[HX_SRC(hxSched[0])], TH_SPAN));
 
 		  // if ( timeout or checksum error ) ...
-		  if(error == 1){
+		  if(thErrorFlag == 1){
 			  thRefreshFlag = 0;		// do not update; resample
 		  }
 		  thState = 3;
@@ -151,64 +378,69 @@ int main(void){
 	  }
 
 	  // if ( 100 ms have passed since previous sample ) ...
-	  if(sampDataFlag >= timerCycles){				// timerCycles*
-		  data = readData(gain);
-//		  data = 0x0000;
-		  num2str24(data);
-
-		  // update voltage (auto-populates string, see ISR)
-		  ADC10CTL0 |= ENC + ADC10SC;             // Sampling and conversion start
-
+	  if(running && (ev & EV_SAMPLE)){
+		  sampleSend();
+	  }
 
-		  // if th data is new, refresh tx_str; else, replace with Xs and leave ADC voltage
-		  if(thRefreshFlag == 1){
-			  th2str(thBuffer);
-			  thRefreshFlag = 0;
-		  }
-		  else{
-			  unsigned char i;
-			  for(i=10; i<18; i++){		// sign, 8bits, comma, 2 bits, comma, 3 bits
-				  if(i==13){
-					  continue;		// do not overwrite comma
-				  }
-				  tx_data_str[i] = 'X';
-				  if(error == 1){
-					  tx_data_str[10] = 'E';
-					  error=0;
-				  }
 
+	  // for ( each command received ) ...
+	  if(ev & EV_CMD){
+		  while((buffer = uart_get_cmd()) != 0){
+			  if(buffer[0] == 'Q'){					// Quit command
+				  P1DIR &= ~BIT6;						// turn off PWM
+				  ctrlStop();
+				  profStop();
+				  stopSampling();						// sleep until the next 'G'
+				  if(frameMode == MODE_BURST)(burstFlush());	// send the partial block
+				  if(frameMode == MODE_DELTA)(deltaFlush());	// or frame
+			  }
+			  else if(buffer[0] == 'S'){			// Stop command
+				  ctrlStop();
+				  profStop();
+				  CCR1 = FULL_STP;						// Stop motors
+			  }
+			  else if(buffer[0] == 'G'){			// Go command
+				  ctrlStop();
+				  profStop();
+				  CCR1 = FULL_STP;
+				  P1DIR |= BIT6;						// reenable PWM
+				  startSampling();
+			  }
+			  else if(buffer[0] == 'B'){			// frame mode command
+				  int m = cmdNum(buffer);
+				  frameMode = (m >= MODE_BINARY && m <= MODE_DELTA) ? m : MODE_ASCII;
+				  deltaReset();						// and burst mode, they share the state
+				  if(frameMode != MODE_BINARY)(trigArm(TRIG_OFF));	// burstBuf is needed, or no binary frames
+				  if(frameMode >= MODE_BURST && filtOrder)(filtConfig(filtRate, 0));	// so is the filter's
+			  }
+			  else if(buffer[0] == 'K'){			// stats dump, sent by statSend
+				  statWait = 1;
+			  }
+			  else if(buffer[0] == 'Z'){			// stats reset
+				  statReset();
+				  cmdReply('Z', 0, 0);
+			  }
+			  else if(buffer[0] == 'P' || buffer[0] == 'A' || buffer[0] == 'C' || buffer[0] == 'T' || buffer[0] == 'U' ||
+					  buffer[0] == 'D' || buffer[0] == 'O' ||
+					  buffer[0] == 'E' || buffer[0] == 'L' || buffer[0] == 'W' ||
+					  buffer[0] == 'H' || buffer[0] == 'J' || buffer[0] == 'M' || buffer[0] == 'V' || buffer[0] == 'Y' ||
+					  buffer[0] == 't'){
+				  config(buffer);					// acquisition parameters
+			  }
+			  else if(buffer[0] == 'X' || buffer[0] == 'I' || buffer[0] == 'N'){
+				  calConfig(buffer);				// calibration
+			  }
+			  else{
+				  pulseOut(buffer);
+//				  pulseOutParabolic(buffer);
 			  }
 		  }
-
-		  uart_write_string(0,FRAME_LENGTH+2);			// add one for sign, one for comma
-		  P1OUT ^= BIT0;							// Toggle P1.0, visual indicator
-		  sampDataFlag = 0;
 	  }
 
+	  statSend();							// a 'K' line waiting for the TX ring
 
-	  // if ( command has been received ) ...
-	  if(eos_flag != 0){
-		  unsigned char i;
-
-		  for(i=0; i<BUFF_LENG; i++){			// for ( each value in rx_data_str ) ...
-			  buffer[i] = uart_get_char(i);			// copy received leading char to buffer variable
-		  }
-
-		  if(buffer[0] == 'Q'){					// Quit command
-			  P1DIR &= ~BIT6;						// turn off PWM
-			  __bis_SR_register(CPUOFF);			// turn off CPU
-		  }
-		  else if(buffer[0] == 'S' || buffer[0] == 'G'){			// Stop command
-			  CCR1 = FULL_STP;						// Stop motors
-		  }
-		  else{
-			  pulseOut(buffer);
-//			  pulseOutParabolic(buffer);
-		  }
-
-		  eos_flag = 0;		// clr eos_flag
-	  }
-
+	  t0 = STAT_TICKS(t0);
+	  if(t0 > statLoopMax)(statLoopMax = t0);
   }
 
 }
@@ -218,16 +450,53 @@ int main(void){
 /*
  * 				   ----- Timer0 A0 interrupt -----
  *
- * This interrupt establishes a sampling frequency as determined
- * by TA0CCR0 (CCR0) above. MSP430 will only sample when sampDataFlag
- * reaches the timerCycles variable. This establishes an fs of 10 Hz.
+ * Start of each PWM period (TA0R wrapped to 0, output set) while an output
+ * profile move is in progress: profStep() writes the pulse width of this
+ * period well before TA0R reaches it. Only enabled during a move, see
+ * profFunks.h.
  *
  */
 #pragma vector=TIMER0_A0_VECTOR
 __interrupt void Timer_A0(void)
 {
-  sampDataFlag++;
-  P1OUT ^= BIT0;
+	STAT_ISR_BEGIN;
+	profStep();
+	STAT_ISR_END(STAT_ISR_TA0_0);
+}
+
+
+/*
+ * 				   ----- Timer1 A1 interrupt -----
+ *
+ * TA1 CCR1 establishes the sampling frequency: it fires every sampTicks
+ * while sampling, and every sampDiv-th time posts EV_SAMPLE so the mainloop
+ * sends one frame per sample period (see setPeriod). sampDataFlag counts
+ * periods since the last frame, more than one are counted in statMissed.
+ * TA1 overflows (TAIFG) extend TA1R to the 32-bit time base. The HX711
+ * itself is read on every conversion by the port 1 interrupt.
+ *
+ */
+#pragma vector=TIMER1_A1_VECTOR
+__interrupt void Timer1_A1(void)
+{
+	STAT_ISR_BEGIN;
+	switch(__even_in_range(TA1IV, 10)){
+	case TA1IV_TACCR1:			// sample tick
+		TA1CCR1 += sampTicks;
+		if(++sampSub >= sampDiv){
+			sampSub = 0;
+			sampDataFlag++;
+			events |= EV_SAMPLE;
+		}
+		break;
+	case TA1IV_TAIFG:			// TA1R wrapped, see tickFunks.h
+		tickHigh++;
+		break;
+	default:
+		break;
+	}
+	STAT_ISR_END(STAT_ISR_TA1_1);
+	if(events)(__bic_SR_register_on_exit(LPM0_bits));
 }
 
 
@@ -242,20 +511,25 @@ __interrupt void Timer_A0(void)
 #pragma vector=TIMER1_A0_VECTOR
 __interrupt void Timer_A1(void)
 {
+	STAT_ISR_BEGIN;
 	// might not work, look into what triggers this interrupt
 	switch(thState){
 	case 0:				// ready to wake thSensor
 		break;
-	case 1:				// ready to sample thSensor
-		P2OUT ^= BIT0;
+	case 1:				// thSensor stopped sending
+		thAbort();
 		break;
 	case 2:				// was waiting for thSensor to wake
+		thArm();
 		thState = 1;
 		break;
+	case 4:				// waiting for mainloop to collect data
+		break;
 	case 3:				// waiting for thSensor to rest
 		loopCounter++;
 		if(loopCounter >= DHT_REST[TH_REST_ST]){		// 10 loops ~=~ 2.5 seconds, max fs = 0.5hz
 			thState = 0;	// ready to wake sensor up
+			events |= EV_TH;
 			loopCounter = 0;
 		}
 		break;
@@ -263,6 +537,8 @@ __interrupt void Timer_A1(void)
 		thState = 3;
 	}
 	TA1CCTL0 &= ~CCIFG;
+	STAT_ISR_END(STAT_ISR_TA1_0);
+	if(events)(__bic_SR_register_on_exit(LPM0_bits));
 }
 
 
@@ -271,17 +547,49 @@ __interrupt void Timer_A1(void)
 #pragma vector=PORT1_VECTOR
 __interrupt void Port_1(void)
 {
-   TH_REST_ST ^= 0x01;				   // Toggle sampling frequency (oversample / undersample)
-   P1IFG &= ~BIT3;                     // P1.3 IFG cleared
+   STAT_ISR_BEGIN;
+   if(P1IFG & P1IE & DATA){		   // temp/humidity sensor bit, time critical
+	   thEdge();
+   }
+   if(P1IFG & P1IE & SDI){			   // HX711 conversion ready
+	   hxIsr();
+   }
+   if(P1IFG & BIT3){
+	   TH_REST_ST ^= 0x01;			   // Toggle sampling frequency (oversample / undersample)
+	   P1IFG &= ~BIT3;                 // P1.3 IFG cleared
+   }
+   STAT_ISR_END(STAT_ISR_PORT1);
+   if(events)(__bic_SR_register_on_exit(LPM0_bits));	// includes events from nested ISRs
+}
+
+// Port 2 interrupt service routine, DOUTs of the extra load cells
+#pragma vector=PORT2_VECTOR
+__interrupt void Port_2(void)
+{
+   STAT_ISR_BEGIN;
+   if(P2IFG & P2IE & HX_P2_PINS){	   // HX711 conversion ready
+	   hxIsr();
+   }
+   STAT_ISR_END(STAT_ISR_PORT2);
+   if(events)(__bic_SR_register_on_exit(LPM0_bits));
 }
 
-// ADC10 interrupt service routine -- measure battery voltage
+/*
+ * ADC10 interrupt service routine -- measure battery voltage
+ *
+ * Runs once the DTC has filled adcBuf and only stops the conversions; the
+ * mainloop turns the block into battMv before it starts the next one. The
+ * voltage divider has a max voltage of 14.4 V, which reads as 894, so
+ *
+ * 		mV = sum/ADC_BLOCK * 14400/894 = (sum * BATT_SCALE) >> 16
+ *
+ */
 #pragma vector=ADC10_VECTOR
 __interrupt void ADC10_ISR(void)
 {
-	adcMem = ADC10MEM;
-	voltage = 14.4*(adcMem/894);		// voltage divider with max voltage of 14.4 V means max adc val is 894
-	volt2str(voltage);
+	STAT_ISR_BEGIN;
+	ADC10CTL0 &= ~ENC;					// stop repeat conversions
+	STAT_ISR_END(STAT_ISR_ADC);
 }
 
 
@@ -301,8 +609,9 @@ __interrupt void ADC10_ISR(void)
  *  === num2str24 ===
  *
  *  This num2str24 command converts a signed 24 bit number to a string of
- *  characters which populate the tx_data_str[] buffer. The string is NUM_LENG
- *  characters long plus a sign character and a comma for parsing.
+ *  characters which populate the load field of the given cell in the
+ *  tx_data_str[] buffer. The string is NUM_LENG characters long plus a sign
+ *  character and a comma for parsing.
  *
  *  If the number is fewer than 7 digits, zeros are placed before the number
  *  and sign bit as MatLab automatically parses the leading zeros. This also
@@ -315,24 +624,20 @@ __interrupt void ADC10_ISR(void)
  *  	num2str24(data) = "00-52000,";
  *
  */
-void num2str24(long int data){
-	unsigned char i, negFlag, ndx;
-	int shft = sizeof(data)*8;		// length of (long int) in bits
+void num2str24(long int data, unsigned char cell){
+	unsigned char i, negFlag = 0, *str = &tx_data_str[9*cell];
 
 	if(data&(0x00800000)){			// if 24th bit is 1 (num is neg)...
 		data = absVal(data);		// get the equivalent positive number
 		negFlag = 1;				// set flag indicating data is negative
 	}
 
-	for(i=8; i>0; i--){				// begin at end of array, iterate to zero
-		tx_data_str[i] = (data % 10)+'0';	// clips LSB and stores to corresponding pos. in str.
-		data /= 10;
-		if(tx_data_str[i] != '0')(ndx=i);	// if ( number is not zero ) { save ndx of this number }
-	}
-
+	fmtDec(data, &str[1], 8);
+	str[9] = ',';
 
 	if(negFlag == 1){
-		tx_data_str[ndx-1] = '-';	// print sign character if data is negative
+		for(i=1; str[i] == '0'; i++);	// find first nonzero digit
+		str[i-1] = '-';		// print sign character if data is negative
 	}
 }
 
@@ -345,54 +650,33 @@ void num2str24(long int data){
  *
  */
 void th2str(volatile char* thData){
-	int temp[2] = { 0 };
+	unsigned int temp[2];
 
-	temp[0] = (int) thData[0]<<8;
-	temp[0] |= thData[1];
-	temp[1] = (int) thData[2]<<8;
-	temp[1] |= thData[3];
+	temp[0] = (unsigned char) thData[0]<<8;
+	temp[0] |= (unsigned char) thData[1];
+	temp[1] = (unsigned char) thData[2]<<8;
+	temp[1] |= (unsigned char) thData[3];
 
 
 	// RH data
-	tx_data_str[9] = ',';
+	tx_data_str[9+LOAD_OFS] = ',';
+	fmtDec(temp[0], &tx_data_str[10+LOAD_OFS], 3);
+	tx_data_str[13+LOAD_OFS] = ',';
 
-	tx_data_str[12] = temp[0]%10+'0';
-	temp[0] /= 10;
-	tx_data_str[11] = temp[0]%10+'0';
-	temp[0] /= 10;
-	tx_data_str[10] = temp[0]%10+'0';
-
-	tx_data_str[13] = ',';
-
-	// Temp Data - check negtative
-	if(temp[1]&0x8000){
-		tx_data_str[14] = '-';
-		temp[1] ^= 0x8000;
-	}
-	else{
-		tx_data_str[14] = '0';
-	}
-
-	tx_data_str[17] = temp[1]%10+'0';
-	temp[1] /= 10;
-	tx_data_str[16] = temp[1]%10+'0';
-	temp[1] /= 10;
-	tx_data_str[15] = temp[1]+'0';
-	tx_data_str[18] = ',';
+	// Temp Data - bit 15 is the sign
+	fmtSigned((temp[1]&0x8000) ? -(long int)(temp[1]&0x7FFF) : temp[1], &tx_data_str[14+LOAD_OFS], 3);
+	tx_data_str[18+LOAD_OFS] = ',';
 
 }
 
-void volt2str(float voltage){
-	int vt = voltage*100;
-
-	tx_data_str[23] = ',';		// end of string
-	tx_data_str[22] = vt%10+'0';
-	vt /= 10;
-	tx_data_str[21] = vt%10+'0';
-	vt /= 10;
-	tx_data_str[20] = vt%10+'0';
-	vt /= 10;
-	tx_data_str[19] = vt%10+'0';
+void volt2str(unsigned int mv){
+	unsigned char digits[5];
+
+	fmtDec(mv+5, digits, 5);		// 10 mV resolution, drop the last digit
+	for(mv=0; mv<4; mv++){
+		tx_data_str[19+LOAD_OFS+mv] = digits[mv];
+	}
+	tx_data_str[23+LOAD_OFS] = ',';		// end of string
 }
 
 
@@ -409,7 +693,7 @@ void volt2str(float voltage){
 
 long int absVal(long int num){
 
-	if(data&(0x00800000)){			// only takes 2's comp if num is < 0
+	if(num&(0x00800000)){			// only takes 2's comp if num is < 0
 		num = ~num;					// undo two's complement
 		num++;						// undo two's complement
 		num &= ~0xFF000000;			// clears most sig. bits
@@ -419,12 +703,550 @@ long int absVal(long int num){
 }
 
 
+/*
+ *  === clockInit ===
+ *
+ *  Loads the DCO calibration for MCLK_HZ and divides SMCLK down to
+ *  SMCLK_HZ (clock.h). Traps if the calibration constants were erased.
+ *
+ */
+void clockInit(void){
+	if(CLK_CALBC1 == 0xFF){
+		while(1);
+	}
+	DCOCTL = 0;								// lowest DCOx and MODx while switching
+	BCSCTL1 = CLK_CALBC1;
+	DCOCTL = CLK_CALDCO;
+	BCSCTL2 = SMCLK_DIVS;
+}
+
+
+/*
+ *  === startSampling / stopSampling ===
+ *
+ *  Start and stop the sample tick, the HX711 interrupt and the temp/humidity
+ *  sensor cycle. While stopped only commands wake the CPU.
+ *
+ */
+void startSampling(void){
+	sampDataFlag = 0;
+	sampSub = 0;
+	TA1CCR1 = TA1R + sampTicks;
+	TA1CCTL1 = CCIE;
+	hxStart();
+	running = 1;
+	events |= EV_TH;			// resume temp/humidity sensor
+}
+
+void stopSampling(void){
+	TA1CCTL1 = 0;
+	hxStop();
+	running = 0;
+}
+
+
+/*
+ *  === setPeriod ===
+ *
+ *  Sets the sample period to p * 10 ms, returns 1 if p is out of range.
+ *  TA1 CCR1 can only count 0.25 sec ahead, so longer periods are split
+ *  into sampDiv equal intervals.
+ *
+ */
+int setPeriod(int p){
+	unsigned char div;
+
+	if(p < 1 || p > 255){
+		return 1;
+	}
+	div = (p + 24) / 25;				// 25 * 10 ms = MAX_TICKS
+	__disable_interrupt();
+	sampTicks = ((unsigned long)p * TICKS_10MS) / div;
+	sampDiv = div;
+	sampSub = 0;
+	sampPeriod = p;
+	__enable_interrupt();
+	return 0;
+}
+
+
+/*
+ *  === gainCode ===
+ *
+ *  Converts an HX711 gain (128, 64 = channel A, 32 = channel B) to the
+ *  number of clocks that selects it, -1 for any other value.
+ *
+ */
+int gainCode(int g){
+	switch(g){
+	case 128:
+		return HI_GAIN;
+	case 64:
+		return MED_GAIN;
+	case 32:
+		return LO_GAIN;
+	default:
+		return -1;
+	}
+}
+
+
+/*
+ *  === frameFits ===
+ *
+ *  Returns 1 if an ASCII frame (the longer format, with source tag) can be
+ *  sent within the sample period p (10 ms steps) at baud rate index br.
+ *
+ */
+int frameFits(int p, int br){
+	// bytes * 10 bits / bps <= p / 100 sec
+	return (unsigned long)(FRAME_LENGTH+8+LOAD_OFS+STAMP_LENG) * 1000 <= (unsigned long)p * uart_bps(br);
+}
+
+
+/*
+ *  === sampleSend ===
+ *
+ *  Sends the frame of this sample period, every EV_SAMPLE while running:
+ *  the loads of the next scheduled source as kept by the mainloop, in
+ *  ASCII or binary (frameMode). Kept out of main() so its locals are off
+ *  the stack while a command runs.
+ *
+ */
+void sampleSend(void){
+	long int* load;
+	unsigned char tag = HX_SRC(hxSched[0]), flags = 0, missed;
+
+	// if ( several sources scheduled ) take turns
+	if(hxSlots > 1){
+		if(frameSlot >= hxSlots)(frameSlot = 0);
+		tag = HX_SRC(hxSched[frameSlot]);
+		frameSlot++;
+	}
+	load = srcData[tag];
+
+	// compensated, then grams or mN, in sample[] (free until the next conversion is popped)
+	if(tcActive(tag)){
+		tcApply(load, sample, srcTime[tag], TH_SPAN);
+		load = sample;
+		flags = FRAME_F_TC;
+	}
+	if(calUnit(tag) != CAL_RAW){
+		calApply(load, sample);
+		load = sample;
+		flags |= FRAME_F_CAL;
+	}
+
+	// update voltage from the last block (ADC10_ISR stopped it), start the next
+	if(!(ADC10CTL0 & ENC)){
+		unsigned int sum = 0;
+		unsigned char i;
+		for(i=0; i<ADC_BLOCK; i++){
+			sum += adcBuf[i];
+		}
+		battMv = ((unsigned long)sum * BATT_SCALE) >> 16;
+		ADC10SA = HAL_ADDR(adcBuf);             // DTC start address
+		ADC10CTL0 |= ENC + ADC10SC;             // Sampling and conversion start
+	}
+
+
+	if(frameMode != MODE_ASCII){
+		flags |= FRAME_F_SRC(tag);
+		if(thRefreshFlag == 1)(flags |= FRAME_F_TH_NEW);
+		if(thErrorFlag == 1){
+			flags |= FRAME_F_TH_ERR;
+			thErrorFlag = 0;
+		}
+		thRefreshFlag = 0;
+
+		uart_write_raw(0,frameSample(load, thBuffer, battMv, flags, srcSeq[tag], srcTime[tag]));
+	}
+	else{
+		unsigned char c, leng = FRAME_LENGTH+2+LOAD_OFS;		// add one for sign, one for comma
+
+		tx_data_str[0] = 0;			// leading byte of the ASCII frame, overwritten by binary frames
+		for(c=0; c<HX_CELLS; c++){
+			num2str24(load[c], c);
+		}
+
+		// if th data is new, refresh tx_str; else, replace with Xs and leave ADC voltage
+		if(thRefreshFlag == 1){
+			th2str(thBuffer);
+			thRefreshFlag = 0;
+		}
+		else{
+			unsigned char i;
+			for(i=10+LOAD_OFS; i<18+LOAD_OFS; i++){		// sign, 8bits, comma, 2 bits, comma, 3 bits
+				if(i==13+LOAD_OFS){
+					tx_data_str[i] = ',';		// a binary frame may have overwritten it
+					continue;
+				}
+				tx_data_str[i] = 'X';
+				if(thErrorFlag == 1){
+					tx_data_str[10+LOAD_OFS] = 'E';
+					thErrorFlag=0;
+				}
+
+			}
+			tx_data_str[18+LOAD_OFS] = ',';
+		}
+		volt2str(battMv);
+
+		// tx_data_str is shorter than the line: queue the loads, then build the rest in its place
+		if(uart_tx_free() < leng+STAMP_LENG+(hxSlots > 1 ? 4 : 0)+2){
+			tx_overflow++;
+		}
+		else{
+			uart_write_raw(0,leng);
+			leng = 0;
+			if(STAMP_LENG){
+				fmtDec(srcSeq[tag], &tx_data_str[0], 3);
+				tx_data_str[3] = ',';
+				fmtDec(srcTime[tag], &tx_data_str[4], 10);
+				tx_data_str[14] = ',';
+				leng = STAMP_LENG;
+			}
+			if(hxSlots > 1){
+				fmtDec(srcGain[tag], &tx_data_str[leng], 3);		// source tag
+				tx_data_str[leng+3] = ',';
+				leng += 4;
+			}
+			uart_write_string(0,leng);
+		}
+	}
+	P1OUT ^= BIT0;							// Toggle P1.0, visual indicator
+	__disable_interrupt();
+	missed = sampDataFlag;
+	sampDataFlag = 0;
+	__enable_interrupt();
+	if(missed > 1)(statMissed += missed-1);	// periods that passed without a frame
+}
+
+
+/*
+ *  === burstRelease ===
+ *
+ *  Frees burstBuf for the filter history: sends what burst or delta mode
+ *  has collected, falls back to binary frames and turns the trigger off.
+ *
+ */
+void burstRelease(void){
+	if(frameMode == MODE_BURST)(burstFlush());
+	if(frameMode == MODE_DELTA)(deltaFlush());
+	if(frameMode > MODE_BINARY)(frameMode = MODE_BINARY);
+	if(trigMode != TRIG_OFF)(trigArm(TRIG_OFF));
+}
+
+
+/*
+ *  === config ===
+ *
+ *  Handles the P, A, C, T, U, D, O, E, L, W, H, J, M, V, Y and t commands
+ *  (see top of file). The value in effect is sent back either way.
+ *
+ */
+void config(char* cmd){
+	unsigned char query = (cmd[1] == '?'), error = 0, i, codes[HX_SCHED_MAX];
+	int num = cmdNum(cmd), list[HX_SCHED_MAX], n;
+
+	switch(cmd[0]){
+	case 'P':							// sample period
+		if(!query){
+			error = !frameFits(num, uart_baud) || setPeriod(num);
+		}
+		cmdReply('P', sampPeriod, error);
+		break;
+	case 'A':							// HX711 gain
+		if(!query){
+			codes[0] = gainCode(num);
+			error = hxSchedule(codes, 1);
+		}
+		cmdReply('A', srcGain[HX_SRC(hxSched[0])], error);
+		break;
+	case 'C':							// HX711 gain schedule
+		if(!query){
+			n = cmdList(cmd, list, HX_SCHED_MAX);
+			for(i=0; i<n; i++){
+				codes[i] = gainCode(list[i]);
+			}
+			error = (n < 1) || hxSchedule(codes, n);
+		}
+		for(i=0; i<hxSlots; i++){
+			list[i] = srcGain[HX_SRC(hxSched[i])];
+		}
+		cmdReplyList('C', list, hxSlots, error);
+		break;
+	case 'T':							// temp/humidity rest period
+		if(!query){
+			error = (num < 4 || num > 255);
+			if(!error)(DHT_REST[TH_REST_ST] = num);
+		}
+		cmdReply('T', DHT_REST[TH_REST_ST], error);
+		break;
+	case 'U':							// baud rate
+		if(query){
+			cmdReply('U', uart_baud, 0);
+		}
+		else if(!frameFits(sampPeriod, num)){	// also rejects unknown indices
+			cmdReply('U', uart_baud, 1);
+		}
+		else{
+			cmdReply('U', num, 0);		// answer at the old rate
+			uart_tx_flush();
+			uart_set_baud(num);
+		}
+		break;
+	case 'D':							// decimation rate
+		if(!query){
+			error = filtConfig(num, filtOrder);
+		}
+		cmdReply('D', filtRate, error);
+		break;
+	case 'O':							// filter order
+		if(!query){
+			if(num > 0 && num <= FILT_MAX_ORDER)(burstRelease());
+			error = filtConfig(filtRate, num);
+		}
+		cmdReply('O', filtOrder, error);
+		break;
+	case 'E':							// trigger mode
+		if(!query){
+			error = (num < 0 || num > (TRIG_DELTA|TRIG_AUTO));
+			if(!error){
+				if(frameMode != MODE_BINARY && (num & ~TRIG_AUTO))(frameMode = MODE_BINARY);
+				if((num & ~TRIG_AUTO) && filtOrder)(filtConfig(filtRate, 0));
+				trigArm(num);
+			}
+		}
+		cmdReply('E', trigMode, error);
+		break;
+	case 'L':							// trigger threshold
+		if(!query){
+			error = (num < 1 || num > 999);
+			if(!error)(trigLevel = (long int)num << 8);
+		}
+		cmdReply('L', trigLevel >> 8, error);
+		break;
+	case 'W':							// send trigger record
+		if(query){
+			cmdReply('W', trigState, 0);
+		}
+		else{
+			num = trigDump();
+			cmdReply('W', num, num == 0);
+			trigSend();
+		}
+		break;
+	case 'H':							// force setpoint, closes the loop
+		if(!query){
+			error = ctrlStart(num);
+			if(!error)(profStop());
+		}
+		cmdReply('H', ctrlSet, error);
+		break;
+	case 'J':							// controller gains
+		if(!query){
+			n = cmdList(cmd, list, 2);
+			error = (n != 2) || ctrlGains(list[0], list[1]);
+		}
+		list[0] = ctrlKp;
+		list[1] = ctrlKi;
+		cmdReplyList('J', list, 2, error);
+		break;
+	case 'M':							// output and integral limits
+		if(!query){
+			n = cmdList(cmd, list, 3);
+			error = (n != 3) || ctrlLimits(list[0], list[1], list[2]);
+		}
+		list[0] = ctrlRev;
+		list[1] = ctrlFor;
+		list[2] = ctrlILim;
+		cmdReplyList('M', list, 3, error);
+		break;
+	case 'V':							// output profile
+		if(!query){
+			n = cmdList(cmd, list, 2);
+			error = (n != 2) || profConfig(list[0], list[1]);
+		}
+		list[0] = profShape;
+		list[1] = profTime;
+		cmdReplyList('V', list, 2, error);
+		break;
+	case 'Y':							// move progress
+		cmdReply('Y', profProgress(), 0);
+		break;
+	case 't':							// temperature compensation table
+		n = query ? 0 : cmdList(cmd, list, 3);
+		if(n == 1){
+			error = (list[0] == 1) ? tcEnd() : (list[0] == 0) ? tcClear() : 1;
+		}
+		else if(n == 2 || n == 3){
+			error = (n == 2) ? tcBegin(list[0], list[1], HX_SRC(hxSched[0])) : tcPoint(list[0], list[1], list[2]);
+			if(!error){
+				cmdReplyList('t', list, n, 0);		// verified in flash
+				break;
+			}
+		}
+		else if(!query){
+			error = 1;
+		}
+		cmdReply('t', tcState, error);
+		break;
+	}
+}
+
+
+/*
+ *  === calConfig ===
+ *
+ *  Handles the X, I and N commands (see top of file) like config. Kept
+ *  apart so the calibration writes run on a smaller frame than config's.
+ *
+ */
+void calConfig(char* cmd){
+	unsigned char query = (cmd[1] == '?'), error = 0, i;
+	int list[2], n = 0;
+	unsigned char tag = HX_SRC(hxSched[0]);
+	long int* load = srcData[tag];		// as in the frames
+
+	if((cmd[0] == 'X' || cmd[0] == 'I') && tcActive(tag)){
+		tcApply(load, sample, srcTime[tag], TH_SPAN);
+		load = sample;
+	}
+	switch(cmd[0]){
+	case 'X':							// tare
+		if(!query){
+			error = !running || calTare(load, tag);
+		}
+		n = calRec ? srcGain[calRec->src] : 0;
+		break;
+	case 'I':							// span
+		if(!query){
+			n = cmdList(cmd, list, 2);
+			error = (n < 1) || (n == 2 && (list[1] < 0 || list[1] >= HX_CELLS)) || !running ||
+					calSpan(load, tag, list[0], (n == 2) ? list[1] : CAL_ALL);
+		}
+		for(i=0, n=0; calRec && i<HX_CELLS; i++){
+			if(calRec->gain[i])(n++);
+		}
+		break;
+	case 'N':							// unit of the loads
+		if(!query){
+			error = calUnits(cmdNum(cmd));
+		}
+		n = calRec ? calRec->unit : CAL_RAW;
+		break;
+	}
+	cmdReply(cmd[0], n, error);			// once, each inlined copy would take a word of the frame
+}
+
+
+/*
+ *  === cmdReply ===
+ *
+ *  Queues "<letter>[!]<3 digits>[,<3 digits>...]\n\r", '!' marks a
+ *  rejected value, values over 999 get 4 digits and over 9999 5, negative
+ *  values a '-' in front. Built in tx_data_str like the frames, to keep it
+ *  off the stack.
+ *
+ */
+void cmdReply(char letter, int val, unsigned char error){
+	cmdReplyList(letter, &val, 1, error);
+}
+
+void cmdReplyList(char letter, int* vals, unsigned char n, unsigned char error){
+	unsigned char* reply = tx_data_str, i = 0, k, w;
+
+	reply[i++] = letter;
+	if(error)(reply[i++] = '!');
+	for(k=0; k<n; k++){
+		unsigned int v = vals[k];
+
+		if(k)(reply[i++] = ',');
+		if(vals[k] < 0){
+			reply[i++] = '-';
+			v = -vals[k];
+		}
+		w = (v > 9999) ? 5 : (v > 999) ? 4 : 3;
+		fmtDec(v, &reply[i], w);
+		i += w;
+	}
+	reply[i++] = '\n';
+	reply[i++] = '\r';
+	uart_queue(reply, i);
+}
+
+
+/*
+ *  === cmdList ===
+ *
+ *  Splits the argument of a command at ',' and converts each part like
+ *  cmdNum, e.g. cmdList("C128,32", vals, 4) = 2 with vals = {128, 32}.
+ *  A part may have a leading '-' and up to five digits, -32767 to 32767.
+ *  Returns -1 if a part is malformed or there are more than max.
+ *
+ */
+int cmdList(char* cmd, int* vals, unsigned char max){
+	unsigned char n = 0, digits = 0, neg = 0;
+	unsigned int v = 0;
+	char* p;
+
+	for(p=&cmd[1]; ; p++){
+		if(*p == ',' || *p == 0){
+			if(digits == 0 || n >= max){
+				return -1;
+			}
+			vals[n++] = neg ? -(int)v : (int)v;
+			if(*p == 0){
+				return n;
+			}
+			v = 0;
+			digits = 0;
+			neg = 0;
+		}
+		else if(*p == '-' && digits == 0 && !neg){
+			neg = 1;
+		}
+		else if(n >= max || *p < '0' || *p > '9' || ++digits > 5 || v > 3276 || (v == 3276 && *p > '7')){
+			return -1;						// the last two: over 32767, checked before v overflows
+		}
+		else{
+			v = v*10 + *p - '0';
+		}
+	}
+}
+
+
+/*
+ *  === cmdNum ===
+ *
+ *  Converts the digits following a command character to a number,
+ *  e.g. cmdNum("D016") = cmdNum("D16") = 16. Returns -1 if there are no
+ *  digits, more than four, or anything else follows the letter.
+ *
+ */
+int cmdNum(char* cmd){
+	unsigned char i;
+	int num = 0;
+
+	for(i=1; cmd[i] != 0; i++){
+		if(cmd[i] < '0' || cmd[i] > '9' || i > 4){
+			return -1;
+		}
+		num *= 10;
+		num += cmd[i] - '0';
+	}
+
+	return (i > 1) ? num : -1;
+}
+
+
 /*
  *  === pulseOut ===
  *
  * 	adjusts the PWM duty cycle according to the buffer variable. From MatLab, a
- * 	string of 4 characters is sent whose firstmost character is a command character
- * 	and the next three characters are a digit percentage
+ * 	command character is sent followed by a percentage, 0-100. Anything else
+ * 	is ignored. Integer math only, so setpoints can be streamed quickly.
  *
  * 	E.g.: F053 commands the PWM to the forward direction with a duty cycle of 53% of
  * 	its full forward duty cycle. For 50 Hz PWM, 53% = 1.765 ms of uptime.
@@ -435,65 +1257,63 @@ long int absVal(long int num){
  * 				R100  |	 100% reverse
  * 				F000  |	 0%, same as stop
  * 				R032  |	 32% reverse
+ *
+ * 	Either one opens the force control loop (ctrlFunks.h) and moves the
+ * 	output along the profile set with V (profFunks.h).
  */
 
 
 void pulseOut(char* cmd){
-	unsigned char i;
-	float pctComm = 0;
+	int pctComm = cmdNum(cmd);
 
-	// convert chars to num
-	for(i=1; i<BUFF_LENG; i++){
-		pctComm *= 10;					// "shift" decimal places left
-		pctComm += cmd[i] - '0';			// subtract ASCII offset
+	if(pctComm < 0 || pctComm > 100){
+		return;
 	}
 
-	pctComm /= 100;
-	float temp;
-
-
 	if((cmd[0] == 'F') || (cmd[0] == 'G')){
-		temp = (FULL_FOR-FULL_STP)*pctComm+FULL_STP;
-//		rx_ndx = 0;
-		CCR1 = (int) temp;
+		ctrlStop();
+		profStart(pwmWidth(pctComm << 8));
 	}
 	else if(cmd[0] == 'R'){
-		temp = (FULL_REV-FULL_STP)*pctComm+FULL_STP;
-//		rx_ndx = 0;
-		CCR1 = (int) temp;
+		ctrlStop();
+		profStart(pwmWidth(-(pctComm << 8)));
 	}
 
 
 }
 
 
-void pulseOutParabolic(char* cmd){
-	unsigned char i;
-	float pctComm = 0;
-
-	// convert chars to num
-	for(i=1; i<BUFF_LENG; i++){
-		pctComm *= 10;					// "shift" decimal places left
-		pctComm += cmd[i] - '0';			// subtract ASCII offset
+/*
+ *  === pwmWidth ===
+ *
+ *  Returns the pulse width (CCR1) for an output in 1/256 percent, -25600
+ *  (full reverse) to 25600 (full forward), between FULL_REV, FULL_STP and
+ *  FULL_FOR. Used by pulseOut and the force controller.
+ *
+ */
+int pwmWidth(int pct){
+	if(pct >= 0){
+		return FULL_STP + (long int)(FULL_FOR-FULL_STP)*pct/(100<<8);
 	}
+	return FULL_STP + (long int)(FULL_STP-FULL_REV)*pct/(100<<8);
+}
 
-	pctComm *= pctComm;
-	pctComm /= 10000;
 
+void pulseOutParabolic(char* cmd){
+	long int pctComm = cmdNum(cmd);
 
+	if(pctComm < 0 || pctComm > 100){
+		return;
+	}
 
-	float temp;
+	pctComm *= pctComm;				// 0-10000
 
 
 	if((cmd[0] == 'F') || (cmd[0] == 'G')){
-		temp = (FULL_FOR-FULL_STP)*pctComm+FULL_STP;
-//		rx_ndx = 0;
-		CCR1 = (int) temp;
+		CCR1 = FULL_STP + (FULL_FOR-FULL_STP)*pctComm/10000;
 	}
 	else if(cmd[0] == 'R'){
-		temp = (FULL_REV-FULL_STP)*pctComm+FULL_STP;
-//		rx_ndx = 0;
-		CCR1 = (int) temp;
+		CCR1 = FULL_STP + (FULL_REV-FULL_STP)*pctComm/10000;
 	}
 
 
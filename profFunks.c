@@ -0,0 +1,126 @@
+/*
+ * profFunks.c
+ *
+ * Motion profile engine for the PWM output, see profFunks.h. The move
+ * state is shared with the Timer0_A0 interrupt, so the mainloop only
+ * changes it with interrupts held off.
+ *
+ */
+
+#include "profFunks.h"
+
+#define		PROF_PT			(65536UL/PROF_N)		// move fraction per table interval
+
+// shapes from 0 to 1 over t = 0..1, only evaluated by the compiler
+#define		PROF_F_TRAP(t)		((t) < 1.0/3 ? 2.25*(t)*(t) : (t) < 2.0/3 ? 1.5*(t) - 0.25 : 1 - 2.25*(1-(t))*(1-(t)))
+#define		PROF_F_SCURVE(t)	((t)*(t)*(t)*(10 - 15*(t) + 6*(t)*(t)))
+#define		PROF_Q(f, i)		((unsigned char)(255*f((i)/(double)PROF_N) + 0.5))
+#define		PROF_ROW(f, i)		PROF_Q(f, i), PROF_Q(f, i+1), PROF_Q(f, i+2), PROF_Q(f, i+3), \
+								PROF_Q(f, i+4), PROF_Q(f, i+5), PROF_Q(f, i+6), PROF_Q(f, i+7)
+#define		PROF_TABLE(f)		{ PROF_ROW(f, 0), PROF_ROW(f, 8), PROF_ROW(f, 16), PROF_ROW(f, 24), \
+								PROF_ROW(f, 32), PROF_ROW(f, 40), PROF_ROW(f, 48), PROF_ROW(f, 56), \
+								PROF_Q(f, 64) }
+
+const unsigned char profTrap[PROF_N+1] = PROF_TABLE(PROF_F_TRAP);
+const unsigned char profScurve[PROF_N+1] = PROF_TABLE(PROF_F_SCURVE);
+
+unsigned char profShape = PROF_OFF;
+unsigned int profTime = 50;					// 10 ms steps
+
+const unsigned char* profTab = 0;			// shape of the move in progress, 0 if none
+unsigned int profPhase, profRate;			// fraction of the move done, 2^-16; per period
+int profFrom, profSpan;						// CCR1 at the start, target - start
+
+
+/*
+ *  === profConfig ===
+ *
+ *  Sets the shape and time (10 ms steps) of the next moves. Returns 1 if
+ *  either is out of range (nothing is changed). A move in progress keeps
+ *  its own.
+ *
+ */
+int profConfig(int shape, int time){
+	if(shape < PROF_OFF || shape > PROF_SCURVE || time < 1 || time > PROF_TIME_MAX){
+		return 1;
+	}
+	profShape = shape;
+	profTime = time;
+	return 0;
+}
+
+
+/*
+ *  === profStart ===
+ *
+ *  Moves CCR1 from where it is to the pulse width 'to' along the current
+ *  shape, or sets it right away with PROF_OFF. The first step is taken at
+ *  the start of the next PWM period.
+ *
+ */
+void profStart(int to){
+	unsigned int periods = profTime * (PROF_HZ/100);
+	unsigned int rate = (65536UL + periods/2) / periods;
+
+	__disable_interrupt();
+	if(profShape == PROF_OFF){
+		profStop();
+		CCR1 = to;
+	}
+	else{
+		profTab = (profShape == PROF_TRAP) ? profTrap : profScurve;
+		profFrom = CCR1;
+		profSpan = to - profFrom;
+		profPhase = 0;
+		profRate = rate;
+		TA0CCTL0 = CCIE;					// also clears a stale CCIFG
+	}
+	__enable_interrupt();
+}
+
+void profStop(void){
+	TA0CCTL0 &= ~CCIE;
+	profTab = 0;
+}
+
+
+/*
+ *  === profStep ===
+ *
+ *  Called by the Timer0_A0 interrupt at the start of each PWM period.
+ *  Advances the move by one period and sets CCR1 for this period; the last
+ *  step lands exactly on the target and ends the move.
+ *
+ */
+void profStep(void){
+	unsigned int phase = profPhase;
+	unsigned char i, f, frac;
+
+	if(profRate > 0xFFFF - phase){			// the next step passes the end
+		CCR1 = profFrom + profSpan;
+		profStop();
+		return;
+	}
+	phase += profRate;
+	profPhase = phase;
+
+	i = phase / PROF_PT;
+	frac = (phase % PROF_PT) / (PROF_PT/256);
+	f = profTab[i] + (((unsigned int)(profTab[i+1] - profTab[i]) * frac) >> 8);
+	CCR1 = profFrom + (((profSpan >> 1) * f) >> 7);		// |span| < 512, no long multiply
+}
+
+
+/*
+ *  === profProgress ===
+ *
+ *  Returns how much of the current move is done in percent, 100 if no
+ *  move is in progress.
+ *
+ */
+int profProgress(void){
+	if(!profTab){
+		return 100;
+	}
+	return ((unsigned long)profPhase * 100) >> 16;
+}
@@ -0,0 +1,46 @@
+/*
+ * profFunks.h - PWM output motion profiles
+ *
+ * Moves the PWM output (TA0CCR1) to a new pulse width over profTime
+ * instead of jumping to it. The Timer0_A0 interrupt steps CCR1 once per
+ * PWM period along one of two shapes, each a table of PROF_N+1 points
+ * (0-255 = start to target) built by the compiler from the formulas below:
+ *
+ * 		PROF_TRAP		trapezoidal velocity, 1/3 accelerate, 1/3 constant,
+ * 						1/3 decelerate
+ * 		PROF_SCURVE		S-curve, 6t^5 - 15t^4 + 10t^3; velocity and
+ * 						acceleration are both zero at either end
+ *
+ * Between table points the output is interpolated linearly. The move
+ * time is rounded to whole PWM periods; the position in the move is a
+ * 16-bit fraction, so long moves run up to 1% long. A new move starts
+ * from wherever the output is, also halfway through a move. The interrupt
+ * only runs during a move.
+ *
+ */
+
+#ifndef PROFFUNKS_H_
+#define PROFFUNKS_H_
+
+#include "hal.h"
+
+#define		PROF_HZ			500			// steps per second, one per PWM period (TA0 CCR0)
+#define		PROF_N			64			// table intervals, PROF_TABLE in profFunks.c lists 65 points
+#define		PROF_TIME_MAX	999			// move time in 10 ms steps
+
+#define		PROF_OFF		0			// profShape, jump straight to the target
+#define		PROF_TRAP		1
+#define		PROF_SCURVE		2
+
+
+extern unsigned char profShape;
+extern unsigned int profTime;
+
+int profConfig(int, int);
+void profStart(int);
+void profStop(void);
+void profStep(void);
+int profProgress(void);
+
+
+#endif /* PROFFUNKS_H_ */
@@ -4,119 +4,222 @@
  *  Created on: Jul 28, 2014
  *      Author: BHill
  */
-#include  "msp430.h"
-#define uart_max 64
-
-unsigned char tx_data_str[uart_max], rx_data_str[uart_max], dec_str[6], eos_flag=0;
-char dec_char[6], cmdAry[5] = { "QSFRG" };
-int tx_ptr,e_tx_ptr, rx_ndx=0;
+#include  "hal.h"
+#include  "serial_handler.h"
+#include  "fmtFunks.h"
+#include  "events.h"
+#include  "clock.h"
+#include  "statFunks.h"
+#define TX_RING_LENG 64				// must be a power of two
+#define RX_RING_LENG 16				// must be a power of two
+#define BAUD_LENG 9					// indices of uart_init(), 300 - 115200 baud
+#define BAUD_DEFAULT 8				// 115200 baud
+#define IS_DELIM(c) ((c) == '\n' || (c) == '\r' || (c) == ';')
+
+unsigned char tx_data_str[uart_max], rx_data_str[CMD_LENG], dec_str[6];
+char dec_char[6];
+unsigned char tx_ring[TX_RING_LENG], rx_ring[RX_RING_LENG];
+volatile unsigned char tx_head=0, tx_tail=0, rx_head=0, rx_tail=0;
+volatile unsigned char tx_wake=0;			// post EV_TX when the ring drains
+unsigned int tx_overflow=0, rx_overflow=0, rx_errors=0;
+unsigned char rx_ndx=0;
+
+// Baud rate 300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200
+// use index of 0 1 2 3... corresponding to the rates above
+// UCBRx and UCBRSx (UCOS16 = 0) are derived from SMCLK_HZ, see clock.h
+const unsigned long bpsvec[BAUD_LENG]={300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200};
+const unsigned int brvec[BAUD_LENG]={UART_BR(300), UART_BR(1200), UART_BR(2400), UART_BR(4800), UART_BR(9600),
+		UART_BR(19200), UART_BR(38400), UART_BR(57600), UART_BR(115200)};
+const unsigned char brsvec[BAUD_LENG]={UART_BRS(300), UART_BRS(1200), UART_BRS(2400), UART_BRS(4800), UART_BRS(9600),
+		UART_BRS(19200), UART_BRS(38400), UART_BRS(57600), UART_BRS(115200)};
+
+CLK_ASSERT(UART_BR(300) <= 0xFFFF, uart_br_fits);
+CLK_ASSERT(UART_BR(115200) >= 3, uart_br_min);		// UCBRx >= 3 with UCOS16 = 0
+unsigned char uart_baud=BAUD_DEFAULT;
 
 void uart_init(int br){
-	volatile int temp=0;
-	//Set baud rate to 300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600
-	// use index of 0 1 2 3... corresponding to the rates above
-	volatile unsigned int brvec[]={0x55, 0x15, 0x0B, 0x05, 0x83, 0x41, 0xA1, 0x16, 139, 69, 35, 17};
-	volatile unsigned int hrvec[]={0xD0,0x34,0x1A,0x0D,6,3,1,1,0,0,0,0};
-
-
-//	BCSCTL1 = CALBC1_16MHZ;                    // Set DCO
-//	DCOCTL = CALDCO_16MHZ;
-	if (CALBC1_1MHZ==0xFF)					// If calibration constant erased
-	{
-		while(1);                               // do not load, trap CPU!!
-	}
-	DCOCTL = 0;                               // Select lowest DCOx and MODx settings
-	BCSCTL1 = CALBC1_1MHZ;                    // Set DCO
-	DCOCTL = CALDCO_1MHZ;
+	// expects the clock set up by clockInit() (main.c)
 
 	P1SEL |= (BIT1+BIT2);                      // P1.1,2 = USCI_A0 TXD/RXD
 	P1SEL2 |= (BIT1+BIT2);
 	//	UCA0CTL1 |= UCSWRST;
 	UCA0CTL1 |= UCSSEL_2;                     // SMCLK
-	UCA0BR0 = 9;
-	UCA0BR1 = 0;
-	UCA0MCTL = UCBRS0;                        // Modulation UCBRSx = 1
-	UCA0CTL1 &= ~UCSWRST;                     // **Initialize USCI state machine**
-	IE2 |= UCA0RXIE;                          // Enable USCI_A0 RX interrupt
+	if(uart_set_baud(br)){
+		uart_set_baud(BAUD_DEFAULT);
+	}
 	__bis_SR_register(GIE);       			// interrupts enabled
 }
 
-void uart_write_string(int vals, int vale){
-	int i;									// writes a string from global variable tx_data_str.  vals is starting pointer and vale is the ending value
-	for(i=vals;i<vale;i++){
-		while (!(IFG2&UCA0TXIFG));
-		UCA0TXBUF=tx_data_str[i];
+/*
+ * Reprograms the baud rate divider, returns 1 if br is not a valid index.
+ * Anything still in the TX ring or shift register is sent at the new rate,
+ * so call uart_tx_flush() first.
+ */
+int uart_set_baud(int br){
+	if(br < 0 || br >= BAUD_LENG){
+		return 1;
+	}
+	UCA0CTL1 |= UCSWRST;
+	UCA0BR0 = brvec[br] & 0xFF;
+	UCA0BR1 = brvec[br] >> 8;
+	UCA0MCTL = brsvec[br];                    // Modulation UCBRSx
+	UCA0CTL1 &= ~UCSWRST;                     // **Initialize USCI state machine**
+	IE2 |= UCA0RXIE;                          // Enable USCI_A0 RX interrupt (reset clears it)
+	uart_baud = br;
+	return 0;
+}
+
+unsigned long uart_bps(int br){
+	if(br < 0 || br >= BAUD_LENG){
+		return 0;
+	}
+	return bpsvec[br];
+}
+
+// wait until every queued byte has left the shift register
+void uart_tx_flush(void){
+	while(tx_head != tx_tail || (UCA0STAT & UCBUSY)){
+		__delay_cycles(100);
+	}
+}
+
+/*
+ * Frames are copied into tx_ring and drained by USCI0TX_ISR, so the
+ * write functions return as soon as the bytes are queued. A frame that
+ * does not fit is dropped whole and counted in tx_overflow.
+ */
+int uart_tx_free(void){
+	return (TX_RING_LENG-1) - ((tx_head-tx_tail) & (TX_RING_LENG-1));
+}
+
+/*
+ * For senders that wait for room instead of dropping: returns 1 if leng
+ * bytes fit now, else 0, and the TX ISR posts EV_TX once the ring has
+ * drained so the mainloop comes round to try again.
+ */
+int uart_tx_room(int leng){
+	tx_wake = 1;								// before the test, the ring may drain meanwhile
+	if(uart_tx_free() < leng){
+		return 0;
+	}
+	tx_wake = 0;
+	return 1;
+}
+
+int uart_queue(unsigned char* buf, int leng){
+	int i;
+	if(uart_tx_free() < leng){
+		tx_overflow++;
+		return 0;
 	}
-	while (!(IFG2&UCA0TXIFG));
-	UCA0TXBUF='\n';
-	while (!(IFG2&UCA0TXIFG));
-	UCA0TXBUF='\r';
+	for(i=0;i<leng;i++){
+		tx_ring[tx_head]=buf[i];
+		tx_head=(tx_head+1) & (TX_RING_LENG-1);
+	}
+	IE2 |= UCA0TXIE;							// TX ISR drains the ring
+	return leng;
 }
 
-void uart_write_fast_string(int vals, int vale){
-	tx_ptr=vals;								// writes a string from global variable tx_data_str.  vals is starting pointer and vale is the ending value
-	e_tx_ptr=vale;								//  Uses interrupts to send out bytes
-	UCA0TXBUF=tx_data_str[tx_ptr];
-	IE2 |= UCA0TXIE;
+void uart_write_string(int vals, int vale){
+	// queues a string from global variable tx_data_str.  vals is starting pointer and vale is the ending value
+	if(uart_tx_free() < vale-vals+2){
+		tx_overflow++;
+		return;
+	}
+	tx_data_str[vale]='\n';
+	tx_data_str[vale+1]='\r';
+	uart_queue(&tx_data_str[vals],vale-vals+2);
+}
 
+void uart_write_raw(int vals, int vale){
+	// same as uart_write_string, without the \n\r terminator (binary frames)
+	uart_queue(&tx_data_str[vals],vale-vals);
 }
 
 
 #pragma vector=USCIAB0TX_VECTOR
 __interrupt void USCI0TX_ISR(void)
 {
-	if (IE2&UCA0TXIE){									//portion of uart_write_fast_string
-		tx_ptr++;
-		if (tx_ptr<e_tx_ptr)
-			UCA0TXBUF=tx_data_str[tx_ptr];
-		else{
-			while (!(IFG2&UCA0TXIFG));
-			UCA0TXBUF='\n';
-			while (!(IFG2&UCA0TXIFG));
-			UCA0TXBUF='\r';
-			IE2 &=~ UCA0TXIE;
+	STAT_ISR_BEGIN;
+	if (tx_tail != tx_head){
+		UCA0TXBUF=tx_ring[tx_tail];
+		tx_tail=(tx_tail+1) & (TX_RING_LENG-1);
+	}
+	else{
+		IE2 &=~ UCA0TXIE;						// ring empty, re-enabled by uart_queue
+		if(tx_wake){
+			tx_wake = 0;
+			events |= EV_TX;
 		}
 	}
-
+	STAT_ISR_END(STAT_ISR_TX);
+	if(events)(__bic_SR_register_on_exit(LPM0_bits));
 }
 
-//  Place data in RX-buffer and set flag
+/*
+ * Received bytes go into rx_ring and are framed into commands by
+ * uart_get_cmd() in the mainloop. Commands end with \n, \r or ';', so the
+ * host can send several back to back ("F050;F060;F070\n"). The mainloop
+ * is also woken once the ring is half full, so a command may be longer
+ * than the ring. A byte that does not fit in the ring is dropped and
+ * counted in rx_overflow.
+ */
 #pragma vector=USCIAB0RX_VECTOR
 __interrupt void USCI0RX_ISR(void)
 {
-	volatile char temp;
+	unsigned char c, next;
+	STAT_ISR_BEGIN;
 	if(IFG2 & UCA0RXIFG){							// Receive data on UART
-
-
-		unsigned char i;
-
-
-		// if a char is received, for it to first position
-		for(i=0; i<5; i++){		// 5 is # of command chars
-			if(UCA0RXBUF == cmdAry[i])(rx_ndx = 0);
+		c = UCA0RXBUF;
+		next = (rx_head+1) & (RX_RING_LENG-1);
+		if(next != rx_tail){
+			rx_ring[rx_head] = c;
+			rx_head = next;
 		}
+		else{
+			rx_overflow++;
+		}
+		if(IS_DELIM(c) || ((rx_head-rx_tail) & (RX_RING_LENG-1)) >= RX_RING_LENG/2){
+			events |= EV_CMD;				// a complete command is waiting, or part of one
+		}
+	}
+	STAT_ISR_END(STAT_ISR_RX);
+	if(events)(__bic_SR_register_on_exit(LPM0_bits));
+}
 
-
-		rx_data_str[rx_ndx]=UCA0RXBUF;				// data is stored in rx_data_str
-		rx_ndx++;
-
-//		 print chars to putty
-//		while (!(IFG2&UCA0TXIFG));
-//		if(rx_ndx < 5){
-//			UCA0TXBUF=UCA0RXBUF;
-//		}
-
-		if (rx_ndx == 5) {		// if ( end of data )
-			eos_flag = 1;
-			rx_ndx = 0;
+/*
+ * Moves received bytes into rx_data_str until a delimiter completes a
+ * command, then returns it in place (NUL terminated, at most CMD_LENG-1
+ * chars). It stays valid until the next call. Returns 0 once the ring is
+ * empty. Empty commands are skipped, longer ones are discarded and
+ * counted in rx_errors.
+ */
+char* uart_get_cmd(void){
+	unsigned char c, leng;
+
+	while(rx_tail != rx_head){
+		c = rx_ring[rx_tail];
+		rx_tail = (rx_tail+1) & (RX_RING_LENG-1);
+
+		if(!IS_DELIM(c)){
+			if(rx_ndx < CMD_LENG){
+				rx_data_str[rx_ndx] = c;
+			}
+			if(rx_ndx < 255)(rx_ndx++);
+			continue;
 		}
 
-		if((rx_data_str[0] == 'G') && (rx_ndx == 0)){					// Go command, only works if rx_ndx == 0
-			__bic_SR_register_on_exit(CPUOFF);		// reenable CPU
-			pulseOut("F000");
-			P1DIR |= BIT6;							// reenable PWM
+		leng = rx_ndx;
+		rx_ndx = 0;
+		if(leng >= CMD_LENG){
+			rx_errors++;
+		}
+		else if(leng > 0){
+			rx_data_str[leng] = 0;
+			return (char*)rx_data_str;
 		}
 	}
+	return 0;
 }
 
 char uart_get_char(int num){
@@ -130,54 +233,19 @@ void uart_set_char(char tx_data,int num){
 
 
 void conv_hex_dec(int val){
-	volatile int temp,prev;
-	unsigned int divider=10000;
-	volatile int n=1,z=0,neg=0;
-	dec_str[0]='0';
-	if (val<0){
-		neg=1;
-		val=val*(-1);
-		dec_str[0]='-';
-	}
-	prev=0;
-	for(n=1;n<6;n++){
-		temp=(val-prev)/divider;
-
-
-		dec_str[n]=temp+0x30;
-		prev=prev+(temp*divider);
-
-
-		divider=divider/10;
-	}
-
+	fmtSigned(val,dec_str,5);
 }
 
 void unsigned_conv_hex_dec(int val){
-	volatile unsigned int temp,prev;
-	unsigned int divider=10000;
-	volatile unsigned int n=1,z=0,neg=0;
 	dec_str[0]='0';
-	prev=0;
-	for(n=1;n<6;n++){
-		temp=(val-prev)/divider;
-
-
-		dec_str[n]=temp+0x30;
-		prev=prev+(temp*divider);
-
-
-		divider=divider/10;
-	}
-
+	fmtDec((unsigned int)val,&dec_str[1],5);
 }
 
 int conv_dec_hex ( void ){
-	volatile int num,k,temp;
+	volatile int num,k;
 	num=0;
 	for (k=1;k<6;k++){
 		num*=10;
-		temp=dec_char[k];
 		if (dec_char[k]>0x39)
 			return 0x7FFF;
 		if (dec_char[k]<0x30)
@@ -8,16 +8,30 @@
 #ifndef SERIAL_HANDLER_H_
 #define SERIAL_HANDLER_H_
 
-extern unsigned char tx_data_str[24], rx_data_str[24],rx_ndx ,dec_str[7],eos_flag;
+#include "loadCellFunks.h"
+
+#define uart_max (HX_CELLS == 1 ? 32 : 64)	// longest piece of a frame built at once (the ASCII one goes in two)
+#define CMD_LENG 16					// longest command including the terminating NUL
+
+extern unsigned char tx_data_str[uart_max], rx_data_str[CMD_LENG], dec_str[6];
 extern char dec_char[6];
+extern unsigned int tx_overflow, rx_overflow, rx_errors;
+extern unsigned char uart_baud;
 void uart_init(int);
+int uart_set_baud(int);
+unsigned long uart_bps(int);
+void uart_tx_flush(void);
+int uart_queue(unsigned char*,int);
+int uart_tx_free(void);
+int uart_tx_room(int);
 void uart_write_string(int,int);
+void uart_write_raw(int,int);
+char* uart_get_cmd(void);
 char uart_get_char(int);
 void uart_set_char(char,int);
 void conv_hex_dec(int);
 void unsigned_conv_hex_dec(int);
 int conv_dec_hex (void);
-//void uart_write_fast_string(int, int);
 
 
 #endif /* SERIAL_HANDLER_H_ */
@@ -0,0 +1,1153 @@
+/*
+ * sim.c - Linux simulator for the loadCellSampler firmware
+ *
+ * Links against the unmodified firmware sources (built with HOST_SIM, see
+ * hal.h) and stands in for the MSP430G2553 and the parts wired to it:
+ *
+ * 		Timer0_A3/Timer1_A3		SMCLK, up and continuous modes, compare
+ * 								interrupts and TAIFG
+ * 		USCI_A0					UART timed from UCA0BRx, backed by a pty
+ * 		ADC10					single conversions and DTC blocks on A3
+ * 		P1/P2					edge interrupts on inputs
+ * 		HX711					DOUT/PD_SCK bit stream on P1.5/P1.4, further
+ * 								chips on P2.1-P2.3 share PD_SCK
+ * 		DHT11/22				start pulse detection and response waveform
+ * 								on P1.7
+ * 		Flash					erase and byte write of information segments
+ * 								D, C and B
+ *
+ * Time only passes at the firmware's hook points: __delay_cycles and
+ * low power mode. Between two events
+ * the simulator jumps straight to the next one, so it runs much faster
+ * than real time. Interrupts are dispatched at the hook points whenever
+ * GIE is set, including nested ones.
+ *
+ * Environment:
+ *
+ * 		SIM_SECONDS		simulated run time (default 10)
+ * 		SIM_INPUT		bytes sent to the firmware 0.5 s after reset (the
+ * 						start up LED flash is over by then), \n and \r
+ * 						escapes allowed, e.g. "G000\n", \w waits 100 ms
+ * 						before the next byte
+ * 		SIM_TXLOG		file receiving every transmitted byte
+ * 		SIM_HX_SPS		HX711 conversion rate (default 80)
+ * 		SIM_HX_CELLS	number of HX711s (default HX_CELLS of the build)
+ * 		SIM_BATT_MV		battery voltage (default 12000)
+ * 		SIM_IMPACT		time in s of a load spike on channel A (+400000
+ * 						counts, decaying in ~50 ms), for the trigger
+ * 		SIM_PLANT		"rate[,tau]": the PWM output drives the load on
+ * 						channel A (see Plant below), for the force
+ * 						controller; e.g. "1000000,0.05"
+ * 		SIM_TEMP		"from,to[,tco]": the DHT temperature ramps from
+ * 						'from' to 'to' C over the run, and the zero of
+ * 						each bridge on channel A drifts with it by about
+ * 						tco counts per C (default 200, slightly curved and
+ * 						more for each further cell), for the temperature
+ * 						compensation; e.g. "5,45"
+ * 		SIM_FLASH		file holding information segments D, C and B,
+ * 						loaded at reset (erased if missing) and written
+ * 						back on exit, so settings survive a "power cycle"
+ * 		SIM_QUIET		do not print the pty name
+ *
+ * A report of throughput, latency and drops is printed on exit, with the
+ * step response of the force controller when SIM_PLANT is set.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "../hal.h"
+#include "../loadCellFunks.h"
+#include "../thFunks.h"
+
+#define NEVER		(~0ULL)
+#define ISR_CYCLES	40			// entry, exit and body overhead charged per interrupt
+
+
+// Registers
+volatile unsigned char IE1, IFG1, IE2, IFG2 = UCA0TXIFG;
+volatile unsigned char DCOCTL, BCSCTL1, BCSCTL2, BCSCTL3;
+volatile unsigned char CALDCO_1MHZ = 0xB1, CALBC1_1MHZ = 0x86, CALDCO_8MHZ = 0x8E, CALBC1_8MHZ = 0x8D;
+volatile unsigned char CALDCO_12MHZ = 0x9C, CALBC1_12MHZ = 0x8E, CALDCO_16MHZ = 0x95, CALBC1_16MHZ = 0x8F;
+volatile unsigned short WDTCTL;
+volatile unsigned char P1IN, P1OUT, P1DIR, P1IFG, P1IES, P1IE, P1SEL, P1SEL2, P1REN;
+volatile unsigned char P2IN, P2OUT, P2DIR, P2IFG, P2IES, P2IE, P2SEL = 0xC0, P2SEL2, P2REN;
+volatile unsigned short TA0CTL, TA0R, TA0CCTL0, TA0CCTL1, TA0CCTL2, TA0CCR0, TA0CCR1, TA0CCR2;
+volatile unsigned short TA1CTL, TA1R, TA1CCTL0, TA1CCTL1, TA1CCTL2, TA1CCR0, TA1CCR1, TA1CCR2;
+volatile unsigned short ADC10CTL0, ADC10CTL1, ADC10MEM, ADC10SA;
+volatile unsigned char ADC10AE0, ADC10DTC0, ADC10DTC1;
+volatile unsigned char UCA0CTL0, UCA0CTL1 = UCSWRST, UCA0BR0, UCA0BR1, UCA0MCTL, UCA0STAT;
+volatile unsigned short FCTL1 = 0x9600, FCTL2 = 0x9642, FCTL3 = 0x9618;
+
+
+// Interrupt service routines, keep in sync with the #pragma vector lines
+void Timer_A1(void) __attribute__((weak));			// TIMER1_A0_VECTOR
+void Timer1_A1(void) __attribute__((weak));			// TIMER1_A1_VECTOR
+void Timer_A0(void) __attribute__((weak));			// TIMER0_A0_VECTOR
+void Timer0_A1(void) __attribute__((weak));			// TIMER0_A1_VECTOR
+void USCI0RX_ISR(void) __attribute__((weak));		// USCIAB0RX_VECTOR
+void USCI0TX_ISR(void) __attribute__((weak));		// USCIAB0TX_VECTOR
+void ADC10_ISR(void) __attribute__((weak));			// ADC10_VECTOR
+void Port_2(void) __attribute__((weak));			// PORT2_VECTOR
+void Port_1(void) __attribute__((weak));			// PORT1_VECTOR
+
+// Firmware counters shown in the report when present
+extern unsigned int tx_overflow __attribute__((weak));
+extern unsigned int hxDropped __attribute__((weak));
+extern unsigned int statLoopMax __attribute__((weak));
+extern unsigned int statIsrMax __attribute__((weak));
+extern unsigned int rx_overflow __attribute__((weak));
+extern unsigned int rx_errors __attribute__((weak));
+extern unsigned int burstDropped __attribute__((weak));
+extern int ctrlSet __attribute__((weak));
+extern unsigned char ctrlOn __attribute__((weak));
+
+
+enum { V_T1A0, V_T1A1, V_T0A0, V_T0A1, V_RX, V_TX, V_ADC, V_P2, V_P1, V_COUNT };
+static const char* vecName[V_COUNT] = { "TIMER1_A0", "TIMER1_A1", "TIMER0_A0", "TIMER0_A1",
+		"USCIAB0RX", "USCIAB0TX", "ADC10", "PORT2", "PORT1" };
+
+
+// Core state
+static unsigned long long now = 0, endTime;
+static double endSec = 10;
+static unsigned long mclk = 1000000;
+#define SIM_SMCLK_DIV	(1UL << ((BCSCTL2 >> 1) & 3))	// DIVS, timers and UART run on SMCLK
+static unsigned int sr = 0;
+static unsigned int* exitSr = 0;			// saved SR of the innermost ISR
+static int isrDepth = 0, sleeping = 0;
+static unsigned long long activeCycles = 0, sleepCycles = 0;
+static unsigned long isrCount[V_COUNT];
+static unsigned long long isrMax[V_COUNT];
+
+
+/*
+ * ----------------------------- Timers -------------------------------
+ */
+typedef struct {
+	volatile unsigned short *ctl, *r, *cctl[3], *ccr[3];
+	unsigned long acc;				// MCLK cycles not yet worth a timer tick
+	unsigned int ivPending;			// TAxIV sources (bit 1 CCR1, 2 CCR2, 5 TAIFG)
+} simTimer;
+
+static simTimer ta[2] = {
+	{ &TA0CTL, &TA0R, { &TA0CCTL0, &TA0CCTL1, &TA0CCTL2 }, { &TA0CCR0, &TA0CCR1, &TA0CCR2 }, 0, 0 },
+	{ &TA1CTL, &TA1R, { &TA1CCTL0, &TA1CCTL1, &TA1CCTL2 }, { &TA1CCR0, &TA1CCR1, &TA1CCR2 }, 0, 0 },
+};
+
+static int timerRunning(simTimer* t){
+	unsigned int mc = *t->ctl & MC_3;
+	return (*t->ctl & TASSEL_2) && mc != MC_0 && !(mc == MC_1 && *t->ccr[0] == 0);
+}
+
+static unsigned long timerPeriod(simTimer* t){
+	return ((*t->ctl & MC_3) == MC_1) ? (unsigned long)*t->ccr[0] + 1 : 65536;
+}
+
+// timer ticks until TAR next equals val, 1..period
+static unsigned long long timerDist(simTimer* t, unsigned long val){
+	unsigned long p = timerPeriod(t), d;
+	if(val >= p){
+		return NEVER;								// CCRx above CCR0 in up mode
+	}
+	d = (val + p - *t->r) % p;
+	return d ? d : p;
+}
+
+static unsigned long long timerNext(simTimer* t){
+	unsigned long long div = SIM_SMCLK_DIV << ((*t->ctl >> 6) & 3), best = 0, d;
+	int i;
+
+	if(!timerRunning(t)){
+		return NEVER;
+	}
+	for(i=0; i<3; i++){
+		if((*t->cctl[i] & CCIE) && !(*t->cctl[i] & CAP)){
+			d = timerDist(t, *t->ccr[i]);
+			if(!best || d < best)(best = d);
+		}
+	}
+	if(*t->ctl & TAIE){
+		d = ((*t->ctl & MC_3) == MC_1) ? timerDist(t, *t->ccr[0]) + 1 : 65536UL - *t->r;
+		if(!best || d < best)(best = d);
+	}
+	if(!best || best == NEVER){
+		return NEVER;
+	}
+	return now + best*div - t->acc;
+}
+
+static void timerAdvance(simTimer* t, unsigned long long cycles){
+	unsigned long div = SIM_SMCLK_DIV << ((*t->ctl >> 6) & 3), p, ticks;
+	int i;
+
+	if(!timerRunning(t)){
+		t->acc = 0;
+		return;
+	}
+	t->acc += cycles;
+	ticks = t->acc / div;
+	t->acc %= div;
+	if(!ticks){
+		return;
+	}
+
+	p = timerPeriod(t);
+	for(i=0; i<3; i++){
+		if(!(*t->cctl[i] & CAP) && timerDist(t, *t->ccr[i]) <= ticks){
+			*t->cctl[i] |= CCIFG;
+			if(i)(t->ivPending |= 1 << i);
+		}
+	}
+	if(((*t->ctl & MC_3) == MC_1 && timerDist(t, *t->ccr[0]) + 1 <= ticks)
+			|| ((*t->ctl & MC_3) != MC_1 && *t->r + ticks >= 65536)){
+		*t->ctl |= TAIFG;
+		t->ivPending |= 1 << 5;
+	}
+	*t->r = (*t->r + ticks) % p;
+}
+
+unsigned int sim_taiv(int n){
+	simTimer* t = &ta[n];
+	unsigned int iv = 0;
+
+	if((t->ivPending & 2) && (*t->cctl[1] & CCIFG)){
+		iv = TA1IV_TACCR1;
+		*t->cctl[1] &= ~CCIFG;
+	}
+	else if((t->ivPending & 4) && (*t->cctl[2] & CCIFG)){
+		iv = TA1IV_TACCR2;
+		*t->cctl[2] &= ~CCIFG;
+	}
+	else if((t->ivPending & 0x20) && (*t->ctl & TAIFG)){
+		iv = TA1IV_TAIFG;
+		*t->ctl &= ~TAIFG;
+	}
+	t->ivPending = 0;
+	if(*t->cctl[1] & CCIFG)(t->ivPending |= 2);
+	if(*t->cctl[2] & CCIFG)(t->ivPending |= 4);
+	if(*t->ctl & TAIFG)(t->ivPending |= 0x20);
+	return iv;
+}
+
+static int timerA1Pending(simTimer* t){
+	return ((*t->cctl[1] & (CCIE|CCIFG)) == (CCIE|CCIFG))
+			|| ((*t->cctl[2] & (CCIE|CCIFG)) == (CCIE|CCIFG))
+			|| ((*t->ctl & (TAIE|TAIFG)) == (TAIE|TAIFG));
+}
+
+
+/*
+ * ------------------------------ UART --------------------------------
+ */
+static int ptyFd = -1;
+static FILE* txLog;
+static volatile unsigned char txCell, rxCell;
+static int txWritten = 0, txShiftBusy = 0, txHeld = 0;
+static unsigned char txShift, txHeldByte;
+static unsigned long long txDone = NEVER, rxNext = 0;
+static unsigned char rxFifo[256], rxWait[256];	// rxWait: 100 ms steps before the byte
+static int rxHead = 0, rxTail = 0;
+static unsigned long txBytes = 0, rxBytes = 0, rxOverruns = 0, hostDrops = 0;
+
+// frame counting on the transmitted stream
+static unsigned char fbuf[300];
+static int fLeng = 0;
+static unsigned long asciiFrames = 0, binFrames = 0, binCrcErr = 0;
+static unsigned long blockFrames = 0, blockSets = 0, blockSeqGaps = 0;
+static int blockSeq = -1, hxNext = -1;		// hxNext: stamp sequence number expected next
+static unsigned long hxSeqGaps = 0;
+static unsigned long eventFrames = 0, eventSets = 0;
+static unsigned long deltaFrames = 0, deltaKeys = 0, deltaSets = 0, deltaBytes = 0;
+static int eventFirst = 0, eventLast = 0;
+
+volatile unsigned char* sim_txbuf(void){
+	txWritten = 1;
+	IFG2 &= ~UCA0TXIFG;
+	return &txCell;
+}
+
+volatile unsigned char* sim_rxbuf(void){
+	IFG2 &= ~UCA0RXIFG;
+	return &rxCell;
+}
+
+static unsigned long uartByteCycles(void){
+	unsigned long brw = UCA0BR0 + 256UL*UCA0BR1;
+	if(UCA0MCTL & UCOS16)(brw *= 16);
+	if(!brw)(brw = 1);
+	return 10*brw*SIM_SMCLK_DIV;					// start, 8 data, stop
+}
+
+static unsigned char crc8(unsigned char* b, int n){
+	unsigned char c = 0;
+	int i, k;
+	for(i=0; i<n; i++){
+		c ^= b[i];
+		for(k=0; k<8; k++)(c = (c & 0x80) ? (c<<1)^0x07 : c<<1);
+	}
+	return c;
+}
+
+static void countFrame(unsigned char b){
+	if(fLeng < (int)sizeof(fbuf))(fbuf[fLeng++] = b);
+	if(fbuf[0] == 0xA5){
+		if(fLeng >= 3 && fLeng == fbuf[2] + 4){
+			if(crc8(&fbuf[1], fLeng-2) != fbuf[fLeng-1]){
+				binCrcErr++;
+			}
+			else if(fbuf[1] == 0x02 && fLeng > 11){		// FRAME_T_BLOCK
+				int n = (fbuf[2]-7) / (3*((fbuf[4] & 0x07) ? (fbuf[4] & 0x07) : 1));
+				blockFrames++;
+				blockSets += n;
+				if(blockSeq >= 0 && fbuf[3] != ((blockSeq+1) & 0xFF))(blockSeqGaps++);
+				blockSeq = fbuf[3];
+				if(hxNext >= 0 && fbuf[5] != hxNext)(hxSeqGaps++);
+				hxNext = (fbuf[5] + n) & 0xFF;
+			}
+			else if(fbuf[1] == 0x03 && fLeng > 12){		// FRAME_T_EVENT
+				int n = (fbuf[2]-8) / (3*((fbuf[5] & 0x07) ? (fbuf[5] & 0x07) : 1));
+				if(!eventFrames)(eventFirst = (signed char)fbuf[4]);
+				eventLast = (signed char)fbuf[4] + n - 1;
+				eventFrames++;
+				eventSets += n;
+			}
+			else if(fbuf[1] == 0x04 && fLeng > 12){		// FRAME_T_DELTA
+				deltaFrames++;
+				if(fbuf[4] & 0x80)(deltaKeys++);
+				deltaSets += fbuf[5];
+				deltaBytes += fLeng;
+				if(blockSeq >= 0 && fbuf[3] != ((blockSeq+1) & 0xFF))(blockSeqGaps++);
+				blockSeq = fbuf[3];
+				if(hxNext >= 0 && fbuf[6] != hxNext)(hxSeqGaps++);
+				hxNext = (fbuf[6] + fbuf[5]) & 0xFF;
+			}
+			else{
+				binFrames++;
+			}
+			fLeng = 0;
+		}
+	}
+	else if(b == '\r'){
+		asciiFrames++;
+		fLeng = 0;
+	}
+	if(fLeng >= (int)sizeof(fbuf))(fLeng = 0);
+}
+
+static void uartEmit(unsigned char b){
+	txBytes++;
+	countFrame(b);
+	if(txLog)(fputc(b, txLog));
+	if(ptyFd >= 0 && write(ptyFd, &b, 1) != 1)(hostDrops++);
+}
+
+static void uartStartShift(unsigned char b){
+	txShift = b;
+	txShiftBusy = 1;
+	UCA0STAT |= UCBUSY;
+	txDone = now + uartByteCycles();
+}
+
+static void uartSample(void){
+	if(txWritten){
+		txWritten = 0;
+		if(UCA0CTL1 & UCSWRST){
+			IFG2 |= UCA0TXIFG;
+		}
+		else if(!txShiftBusy){
+			uartStartShift(txCell);
+			IFG2 |= UCA0TXIFG;					// buffer moved to shift register
+		}
+		else{
+			txHeld = 1;							// waits in UCA0TXBUF
+			txHeldByte = txCell;
+		}
+	}
+}
+
+static void uartEvents(void){
+	unsigned char b;
+
+	if(now >= txDone){
+		uartEmit(txShift);
+		txShiftBusy = 0;
+		UCA0STAT &= ~UCBUSY;
+		txDone = NEVER;
+		if(txHeld){
+			txHeld = 0;
+			uartStartShift(txHeldByte);
+			IFG2 |= UCA0TXIFG;
+		}
+	}
+
+	if(now >= rxNext){
+		rxNext = now + uartByteCycles();
+		if(ptyFd >= 0 && ((rxHead+1) & 255) != rxTail && read(ptyFd, &b, 1) == 1){
+			rxFifo[rxHead] = b;
+			rxHead = (rxHead+1) & 255;
+		}
+		if(rxTail != rxHead && rxWait[rxTail]){
+			rxNext = now + rxWait[rxTail] * (mclk / 10);
+			rxWait[rxTail] = 0;
+		}
+		else if(rxTail != rxHead && !(UCA0CTL1 & UCSWRST)){
+			if(IFG2 & UCA0RXIFG){
+				rxOverruns++;
+				UCA0STAT |= UCOE;
+			}
+			rxCell = rxFifo[rxTail];
+			rxTail = (rxTail+1) & 255;
+			IFG2 |= UCA0RXIFG;
+			rxBytes++;
+		}
+	}
+}
+
+static void uartOpen(void){
+	struct termios tio;
+	const char* in = getenv("SIM_INPUT");
+	const char* log = getenv("SIM_TXLOG");
+
+	ptyFd = posix_openpt(O_RDWR | O_NOCTTY);
+	if(ptyFd >= 0 && grantpt(ptyFd) == 0 && unlockpt(ptyFd) == 0){
+		if(tcgetattr(ptyFd, &tio) == 0){
+			cfmakeraw(&tio);
+			tcsetattr(ptyFd, TCSANOW, &tio);
+		}
+		fcntl(ptyFd, F_SETFL, O_NONBLOCK);
+		if(!getenv("SIM_QUIET"))(fprintf(stderr, "sim: UART on %s\n", ptsname(ptyFd)));
+	}
+	else{
+		ptyFd = -1;
+	}
+
+	if(log)(txLog = fopen(log, "wb"));
+
+	for(; in && *in; in++){
+		unsigned char c = *in;
+		if(c == '\\' && in[1] == 'w'){
+			rxWait[rxHead]++;
+			in++;
+			continue;
+		}
+		if(c == '\\' && in[1] == 'n'){ c = '\n'; in++; }
+		else if(c == '\\' && in[1] == 'r'){ c = '\r'; in++; }
+		rxFifo[rxHead] = c;
+		rxHead = (rxHead+1) & 255;
+	}
+}
+
+
+/*
+ * ------------------------------ ADC10 -------------------------------
+ */
+static void* dtcPtr;
+static unsigned long long adcDone = NEVER;
+static unsigned int battMvSim = 12000;
+
+// approximately the caller's stack pointer, for stack painting (bench/)
+__attribute__((noinline)) unsigned long sim_sp(void){
+	return (unsigned long)__builtin_frame_address(0);
+}
+
+unsigned short sim_addr(void* p){
+	dtcPtr = p;
+	return 0x0200;
+}
+
+static unsigned short adcRead(void){
+	unsigned long v = (unsigned long)battMvSim * 894 / 14400;
+	v += rand() % 3;
+	return v > 1023 ? 1023 : v;
+}
+
+static void adcSample(void){
+	if((ADC10CTL0 & (ADC10ON|ENC|ADC10SC)) == (ADC10ON|ENC|ADC10SC) && adcDone == NEVER){
+		ADC10CTL0 &= ~ADC10SC;
+		ADC10CTL1 |= ADC10BUSY;
+		adcDone = now + (ADC10DTC1 ? ADC10DTC1 : 1) * 13 * mclk / 1000000;
+	}
+}
+
+static void adcEvents(void){
+	int i;
+
+	if(now < adcDone){
+		return;
+	}
+	adcDone = NEVER;
+	ADC10CTL1 &= ~ADC10BUSY;
+	if(ADC10DTC1 && dtcPtr){
+		for(i=0; i<ADC10DTC1; i++){
+			((unsigned int*)dtcPtr)[i] = adcRead();
+		}
+	}
+	ADC10MEM = adcRead();
+	ADC10CTL0 |= ADC10IFG;
+}
+
+
+/*
+ * ------------------------------ Plant -------------------------------
+ *
+ * A motor with a first order lag (plantTau) drives an actuator against a
+ * stiff spring, so the force on channel A changes at up to plantRate
+ * counts/s. The PWM is read as a servo pulse: 1500 us stop, 1920 us full
+ * forward, 1000 us full reverse, no output while P1.6 is not driven.
+ *
+ * The step response is measured from the last change of setpoint with the
+ * loop closed (ctrlOn, ctrlSet): 10-90% rise, overshoot, and when the
+ * force last left a band of 2% of the step (at least 1000 counts).
+ */
+static double plantRate = 0, plantTau = 0.05, plantForce = 0, plantVel = 0;
+static unsigned long long plantAt = 0;
+static int plantSet = -1;
+static unsigned long long stepAt, stepOutAt;
+static double stepFrom, stepTo, stepPeak, stepT10, stepT90, stepOut;	// stepPeak: fraction of the step
+static double lastDt, lastSum, lastMin, lastMax;	// error over the last second
+
+static double plantDuty(void){
+	double us, u;
+
+	if(!(P1DIR & BIT6) || !(P1SEL & BIT6) || !timerRunning(&ta[0])){
+		return 0;
+	}
+	us = TA0CCR1 * 1e6 * (SIM_SMCLK_DIV << ((TA0CTL >> 6) & 3)) / mclk;
+	u = (us >= 1500) ? (us-1500)/420 : (us-1500)/500;
+	return u > 1 ? 1 : u < -1 ? -1 : u;
+}
+
+static void plantTrack(double u, double dt){
+	int set = (&ctrlOn && ctrlOn) ? ctrlSet : -1;
+	double d, s, e, band;
+
+	if(set != plantSet){
+		plantSet = set;
+		stepAt = stepOutAt = now;
+		stepFrom = plantForce;
+		stepPeak = 0;
+		stepTo = 256.0*set;
+		stepT10 = stepT90 = -1;
+		stepOut = lastDt = lastSum = 0;
+		lastMin = 1e30;
+		lastMax = -1e30;
+	}
+	if(plantSet < 0){
+		return;
+	}
+
+	d = stepTo - stepFrom;
+	e = plantForce - stepTo;
+	band = fabs(d)/50 > 1000 ? fabs(d)/50 : 1000;
+	if(fabs(d) > band){
+		s = (plantForce - stepFrom) / d;
+		if(stepT10 < 0 && s >= 0.1)(stepT10 = (double)(now - stepAt) / mclk);
+		if(stepT90 < 0 && s >= 0.9)(stepT90 = (double)(now - stepAt) / mclk);
+		if(s > stepPeak)(stepPeak = s);
+	}
+	if(fabs(e) > band)(stepOutAt = now);
+	if(fabs(u) > stepOut)(stepOut = fabs(u));
+	if(now + mclk >= endTime){
+		lastDt += dt;
+		lastSum += e*dt;
+		if(e < lastMin)(lastMin = e);
+		if(e > lastMax)(lastMax = e);
+	}
+}
+
+static void plantEvents(void){
+	double dt = (double)(now - plantAt) / mclk, u, v, a;
+
+	plantAt = now;
+	if(!plantRate){
+		return;
+	}
+	u = plantDuty();								// in effect since plantAt
+	v = plantRate*u;
+	a = exp(-dt/plantTau);
+	plantForce += v*dt + (plantVel - v)*plantTau*(1 - a);
+	plantVel = v + (plantVel - v)*a;
+	plantTrack(u, dt);
+}
+
+static void plantReport(void){
+	double d = stepTo - stepFrom, band = fabs(d)/50 > 1000 ? fabs(d)/50 : 1000;
+
+	if(!plantRate || plantSet < 0){
+		return;
+	}
+	fprintf(stderr, "plant      H%03d (%.0f counts) at %.2f s from %.0f: ", plantSet, stepTo,
+			(double)stepAt / mclk, stepFrom);
+	if(fabs(d) > band && stepT90 >= 0){
+		fprintf(stderr, "rise %.3f s, overshoot %.1f%%, ", stepT90 - stepT10, stepPeak > 1 ? 100*(stepPeak-1) : 0);
+	}
+	else if(fabs(d) > band){
+		fprintf(stderr, "never reached 90%%, ");
+	}
+	if(now - stepOutAt >= mclk/2){
+		fprintf(stderr, "settled in %.3f s (+-%.0f)\n", (double)(stepOutAt - stepAt) / mclk, band);
+	}
+	else{
+		fprintf(stderr, "NOT settled (+-%.0f)\n", band);
+	}
+	fprintf(stderr, "           last %.1f s: error mean %.0f, p-p %.0f counts; output peak %.0f%%\n",
+			lastDt, lastDt > 0 ? lastSum/lastDt : 0, lastDt > 0 ? lastMax-lastMin : 0, 100*stepOut);
+}
+
+
+/*
+ * ------------------------------ HX711 -------------------------------
+ */
+#ifndef HX_CELLS
+#define HX_CELLS	1
+#endif
+#define HX_MAX		4								// DOUTs on P1.5, P2.1, P2.2, P2.3
+
+typedef struct {
+	unsigned long long ready, readyAt;
+	int bit, gainNext, gainCur, gainOld, settle;
+	long value;
+	int dout;
+} hxChip;
+
+static hxChip hx[HX_MAX];
+static int hxCells = HX_CELLS, hxPulses = 0, hxClk = 0;
+static unsigned long long hxClkHighAt;
+static unsigned long hxConv = 0, hxReads = 0, hxMissed = 0, hxPowerDown = 0;
+static double hxLatSum = 0, hxLatMax = 0;
+static unsigned long hxSps = 80;
+static double impactAt = -1;
+static double tempFrom = 0, tempTo = 0, tempTco = 200;
+static int tempSet = 0;
+
+// ambient temperature in C at t seconds, SIM_TEMP
+static double simTemp(double t){
+	return tempFrom + (tempTo - tempFrom) * t / endSec;
+}
+
+static long hxSignal(int c, double t, int gain){
+	double v;
+
+	if(gain == 26){									// channel B, second bridge
+		v = -40000 + 5000*sin(2*M_PI*0.2*t);
+	}
+	else{
+		v = plantRate ? plantForce/hxCells : 150000 - 50000*c + 60000*sin(2*M_PI*(0.5+0.25*c)*t);
+		if(impactAt >= 0 && t >= impactAt)(v += 400000*exp(-(t-impactAt)/0.05));
+		if(tempSet){									// zero drift, a little curved
+			double d = simTemp(t) - 25;
+			v += tempTco * (1 + 0.25*c) * (d + 0.02*d*d);
+		}
+		if(gain == 27)(v /= 2);
+	}
+	v += (rand() % 201) - 100;
+	return (long)v & 0x00FFFFFF;
+}
+
+static long sx24(long v){
+	return (v & 0x00800000) ? v - 0x01000000 : v;
+}
+
+// conversion period of chip c, each internal oscillator is 0.3% off the last
+static unsigned long long hxPeriod(int c){
+	return (unsigned long long)(mclk / (hxSps * (1.0 + 0.003*c)));
+}
+
+static unsigned long long hxNextReady(void){
+	unsigned long long t = NEVER;
+	int c;
+	for(c=0; c<hxCells; c++){
+		if(hx[c].ready < t)(t = hx[c].ready);
+	}
+	return t;
+}
+
+static void hxResync(void){
+	int c;
+	for(c=0; c<hxCells; c++){
+		hx[c].ready = now + hxPeriod(c);
+	}
+}
+
+static void hxEvents(void){
+	int c;
+
+	for(c=0; c<hxCells; c++){
+		hxChip* h = &hx[c];
+		if(now < h->ready){
+			continue;
+		}
+		hxConv++;
+		if(h->bit == 0)(hxMissed++);					// previous conversion never read
+		if(h->bit <= 0){
+			h->value = hxSignal(c, (double)now / mclk, h->gainCur);
+			if(h->settle){								// filter still settling, blend in the old setting
+				long old = sx24(hxSignal(c, (double)now / mclk, h->gainOld));
+				h->value = (old + (sx24(h->value) - old) * (4 - h->settle) / 4) & 0x00FFFFFF;
+				h->settle--;
+			}
+			h->bit = 0;
+			h->dout = 0;
+			h->readyAt = now;
+		}
+		h->ready += hxPeriod(c);
+	}
+}
+
+static void hxSample(void){
+	int clk = (P1DIR & CLK) && (P1OUT & CLK);
+	int c, first = 1;
+
+	for(c=0; c<hxCells; c++){
+		hxChip* h = &hx[c];
+
+		if(clk && !hxClk){							// PD_SCK rising edge
+			if(h->bit >= 0 && h->bit < 24){
+				h->dout = (h->value >> (23-h->bit)) & 1;
+				h->bit++;
+			}
+			else if(h->bit == 24){
+				if(first)(hxPulses++);
+				first = 0;
+				h->dout = 1;
+				if(hxPulses == 1){
+					double lat = (double)(now - h->readyAt) * 1e6 / mclk;
+					hxReads++;
+					hxLatSum += lat;
+					if(lat > hxLatMax)(hxLatMax = lat);
+				}
+			}
+		}
+		else if(!clk && hxClk){
+			if(h->bit == 24 && hxPulses){
+				h->gainNext = 24 + hxPulses;
+			}
+		}
+	}
+	if(clk && !hxClk){
+		hxClkHighAt = now;
+	}
+	else if(!clk && hxClk){
+		if((now - hxClkHighAt) * 1000000 / mclk > 60)(hxPowerDown++);
+	}
+	hxClk = clk;
+
+	if(hxPulses && !clk && now - hxClkHighAt > mclk / 100000){
+		for(c=0; c<hxCells; c++){						// gain pulses finished
+			if(hx[c].bit == 24){
+				if(hx[c].gainNext != hx[c].gainCur){	// first 3 conversions are off
+					hx[c].gainOld = hx[c].gainCur;
+					hx[c].settle = 3;
+				}
+				hx[c].gainCur = hx[c].gainNext;
+				hx[c].bit = -1;
+			}
+		}
+		hxPulses = 0;
+	}
+}
+
+
+/*
+ * ------------------------------ DHT ---------------------------------
+ */
+static unsigned long long dhtLowSince = NEVER, dhtT[90];
+static int dhtN = 0, dhtPos = 0, dhtDrive = 0, dhtHostLow = 0;
+static unsigned long dhtStarts = 0;
+
+static void dhtRespond(void){
+	unsigned char b[5];
+	int rh = 456 + rand() % 20, t = 234 + rand() % 10, i, us = 30;
+	unsigned long long t0 = now;
+
+	if(tempSet)(t = (int)floor(simTemp((double)now / mclk) * 10 + 0.5) + rand() % 3 - 1);
+	if(t < 0)(t = 0x8000 | -t);						// sign and magnitude
+	b[0] = rh >> 8; b[1] = rh; b[2] = t >> 8; b[3] = t;
+	b[4] = b[0]+b[1]+b[2]+b[3];
+
+	dhtN = 0;
+	#define EDGE(u)		(dhtT[dhtN++] = t0 + (unsigned long long)(u) * mclk / 1000000)
+	EDGE(us); us += 80;								// response low
+	EDGE(us); us += 80;								// response high
+	for(i=0; i<40; i++){
+		EDGE(us); us += 50;
+		EDGE(us); us += (b[i>>3] & (0x80 >> (i&7))) ? 70 : 27;
+	}
+	EDGE(us); us += 50;
+	EDGE(us);
+	#undef EDGE
+	dhtPos = 0;
+	dhtStarts++;
+}
+
+static void dhtSample(void){
+	int hostLow = (P1DIR & DATA) && !(P1OUT & DATA);
+
+	if(hostLow && !dhtHostLow){
+		dhtLowSince = now;
+	}
+	else if(!hostLow && dhtHostLow && dhtPos >= dhtN){
+		if((now - dhtLowSince) * 1000000 / mclk >= 800)(dhtRespond());
+	}
+	dhtHostLow = hostLow;
+}
+
+static unsigned long long dhtNext(void){
+	return dhtPos < dhtN ? dhtT[dhtPos] : NEVER;
+}
+
+static void dhtEvents(void){
+	while(dhtPos < dhtN && dhtT[dhtPos] <= now){
+		dhtDrive = !(dhtPos & 1);					// even edges pull low
+		dhtPos++;
+	}
+	if(dhtPos >= dhtN)(dhtDrive = 0);
+}
+
+
+/*
+ * ------------------------------ Ports -------------------------------
+ */
+static void portUpdate(void){
+	unsigned char in1 = 0, in2, changed, fall;
+	int c;
+
+	in1 |= P1OUT & P1DIR;
+	if(!(P1DIR & SDI) && hx[0].dout)(in1 |= SDI);
+	if(!(P1DIR & DATA) && !dhtDrive)(in1 |= DATA);
+	if(!(P1DIR & BIT3))(in1 |= BIT3);				// button released, pulled up
+
+	changed = (in1 ^ P1IN) & ~P1DIR & ~P1SEL;
+	fall = changed & ~in1;
+	P1IFG |= (fall & P1IES) | (changed & in1 & ~P1IES);
+	P1IN = in1;
+
+	in2 = (P2OUT & P2DIR) | (~P2DIR & 0x3E);		// unconnected inputs float high
+	for(c=1; c<hxCells; c++){
+		if(!(P2DIR & (1<<c)) && !hx[c].dout)(in2 &= ~(1<<c));
+	}
+	changed = (in2 ^ P2IN) & ~P2DIR & ~P2SEL;
+	fall = changed & ~in2;
+	P2IFG |= (fall & P2IES) | (changed & in2 & ~P2IES);
+	P2IN = in2;
+}
+
+
+/*
+ * ------------------------------ Core --------------------------------
+ */
+static void updateClock(void){
+	unsigned long old = mclk;
+
+	if(BCSCTL1 == CALBC1_16MHZ && DCOCTL == CALDCO_16MHZ)(mclk = 16000000);
+	else if(BCSCTL1 == CALBC1_12MHZ && DCOCTL == CALDCO_12MHZ)(mclk = 12000000);
+	else if(BCSCTL1 == CALBC1_8MHZ && DCOCTL == CALDCO_8MHZ)(mclk = 8000000);
+	else(mclk = 1000000);
+
+	if(mclk != old){								// only expected during start up
+		endTime = now + (unsigned long long)(endSec * mclk);
+		hxResync();
+		rxNext = now + mclk / 2;
+	}
+}
+
+static void sampleAll(void){
+	updateClock();
+	uartSample();
+	adcSample();
+	hxSample();
+	dhtSample();
+	portUpdate();
+}
+
+static void runIsr(int v, void (*isr)(void)){
+	unsigned int saved = sr, *outer = exitSr;
+	unsigned long long t0 = now;
+	int wasSleeping = sleeping;
+
+	if(!isr){
+		fprintf(stderr, "sim: %s pending with no handler\n", vecName[v]);
+		exit(1);
+	}
+	isrCount[v]++;
+	sleeping = 0;
+	isrDepth++;
+	exitSr = &saved;
+	sr &= ~(GIE | CPUOFF | SCG0 | SCG1 | OSCOFF);
+	isr();
+	sampleAll();
+	sim_delay(ISR_CYCLES);
+	if(now - t0 > isrMax[v])(isrMax[v] = now - t0);
+	isrDepth--;
+	exitSr = outer;
+	sr = saved;
+	sleeping = wasSleeping && (sr & CPUOFF);
+}
+
+static int dispatchOne(void){
+	if(!(sr & GIE)){
+		return 0;
+	}
+	if((TA1CCTL0 & (CCIE|CCIFG)) == (CCIE|CCIFG)){
+		TA1CCTL0 &= ~CCIFG;
+		runIsr(V_T1A0, Timer_A1);
+	}
+	else if(timerA1Pending(&ta[1])){
+		runIsr(V_T1A1, Timer1_A1);
+	}
+	else if((TA0CCTL0 & (CCIE|CCIFG)) == (CCIE|CCIFG)){
+		TA0CCTL0 &= ~CCIFG;
+		runIsr(V_T0A0, Timer_A0);
+	}
+	else if(timerA1Pending(&ta[0])){
+		runIsr(V_T0A1, Timer0_A1);
+	}
+	else if((IE2 & UCA0RXIE) && (IFG2 & UCA0RXIFG)){
+		runIsr(V_RX, USCI0RX_ISR);
+	}
+	else if((IE2 & UCA0TXIE) && (IFG2 & UCA0TXIFG)){
+		runIsr(V_TX, USCI0TX_ISR);
+	}
+	else if((ADC10CTL0 & (ADC10IE|ADC10IFG)) == (ADC10IE|ADC10IFG)){
+		ADC10CTL0 &= ~ADC10IFG;
+		runIsr(V_ADC, ADC10_ISR);
+	}
+	else if(P2IFG & P2IE){
+		runIsr(V_P2, Port_2);
+	}
+	else if(P1IFG & P1IE){
+		runIsr(V_P1, Port_1);
+	}
+	else{
+		return 0;
+	}
+	return 1;
+}
+
+static void advance(unsigned long long cycles, int stopOnWake){
+	unsigned long long target = now + cycles, t, n;
+
+	sampleAll();
+	while(dispatchOne());
+
+	while(now < target){
+		t = target;
+		if((n = timerNext(&ta[0])) < t)(t = n);
+		if((n = timerNext(&ta[1])) < t)(t = n);
+		if(txDone < t)(t = txDone);
+		if(rxNext < t)(t = rxNext);
+		if(adcDone < t)(t = adcDone);
+		if((n = hxNextReady()) < t)(t = n);
+		if((n = dhtNext()) < t)(t = n);
+		if(t <= now)(t = now + 1);
+		if(t > endTime)(t = endTime);
+
+		timerAdvance(&ta[0], t - now);
+		timerAdvance(&ta[1], t - now);
+		if(sleeping && !isrDepth)(sleepCycles += t - now);
+		else(activeCycles += t - now);
+		now = t;
+		plantEvents();
+		if(now >= endTime){
+			exit(0);
+		}
+
+		uartEvents();
+		adcEvents();
+		hxEvents();
+		dhtEvents();
+		portUpdate();
+		while(dispatchOne());
+		if(stopOnWake && !(sr & CPUOFF)){
+			break;
+		}
+	}
+}
+
+void sim_delay(unsigned long int n){
+	advance(n, 0);
+}
+
+void sim_bis_sr(unsigned int bits){
+	sr |= bits;
+	sampleAll();
+	while(dispatchOne());
+	if((sr & CPUOFF) && !isrDepth){
+		sleeping = 1;
+		while(sr & CPUOFF){
+			advance(mclk, 1);
+		}
+		sleeping = 0;
+	}
+}
+
+void sim_bic_sr(unsigned int bits){
+	sr &= ~bits;
+}
+
+void sim_bis_sr_on_exit(unsigned int bits){
+	if(exitSr)(*exitSr |= bits);
+}
+
+void sim_bic_sr_on_exit(unsigned int bits){
+	if(exitSr)(*exitSr &= ~bits);
+}
+
+unsigned int sim_get_sr(void){
+	return sr;
+}
+
+
+/*
+ * ------------------------------ Flash -------------------------------
+ *
+ * Writes to sim_info come through sim_flash_wr (HAL_FLASH_WR) and follow
+ * the flash controller: LOCK clear and FCTL2 giving a 257-476 kHz clock,
+ * then ERASE erases the 64 byte segment written to and WRT programs the
+ * byte, which can only clear bits. Anything else is an access violation
+ * (ACCVIFG). The CPU is held for the erase or program time, nothing else
+ * runs meanwhile.
+ */
+#define FLASH_ERASE_TICKS	4819		// segment erase, flash clocks
+#define FLASH_BYTE_TICKS	30
+
+unsigned char sim_info[0xC0] __attribute__((aligned(8)));
+static const char* flashFile;
+static unsigned long flashErases, flashBytes, flashViolations;
+
+void sim_flash_wr(unsigned char* p, unsigned char b){
+	long i = p - sim_info;
+	unsigned long fclk = ((FCTL2 & 0xC0) == FSSEL_1 ? mclk : mclk / SIM_SMCLK_DIV) / ((FCTL2 & 0x3F) + 1);
+	unsigned int saved = sr;
+
+	if(i < 0 || i >= (long)sizeof(sim_info)){
+		fprintf(stderr, "sim: flash write outside information segments D-B\n");
+		exit(1);
+	}
+	if((FCTL3 & LOCK) || !(FCTL1 & (ERASE|WRT)) || (FCTL2 & 0xC0) == FSSEL_0 ||
+			fclk < 257000 || fclk > 476000){
+		flashViolations++;
+		FCTL3 |= ACCVIFG;
+		return;
+	}
+	sr &= ~GIE;
+	if(FCTL1 & ERASE){
+		memset(&sim_info[i & ~63], 0xFF, 64);
+		FCTL1 &= ~ERASE;						// segment erase ends by itself
+		flashErases++;
+		advance((unsigned long long)FLASH_ERASE_TICKS * mclk / fclk, 0);
+	}
+	else{
+		sim_info[i] &= b;
+		flashBytes++;
+		advance((unsigned long long)FLASH_BYTE_TICKS * mclk / fclk, 0);
+	}
+	sr = saved;
+}
+
+static void flashLoad(void){
+	FILE* f;
+
+	memset(sim_info, 0xFF, sizeof(sim_info));
+	if((flashFile = getenv("SIM_FLASH")) && (f = fopen(flashFile, "rb"))){
+		if(fread(sim_info, 1, sizeof(sim_info), f) != sizeof(sim_info)){
+			memset(sim_info, 0xFF, sizeof(sim_info));
+		}
+		fclose(f);
+	}
+}
+
+static void flashSave(void){
+	FILE* f;
+
+	if(flashErases || flashBytes || flashViolations){
+		fprintf(stderr, "flash      %lu segment erases, %lu bytes written, %lu access violations\n",
+				flashErases, flashBytes, flashViolations);
+	}
+	if(flashFile && (f = fopen(flashFile, "wb"))){
+		fwrite(sim_info, 1, sizeof(sim_info), f);
+		fclose(f);
+	}
+}
+
+
+/*
+ * ------------------------------ Setup -------------------------------
+ */
+static void report(void){
+	double secs = (double)now / mclk;
+	int v;
+
+	fprintf(stderr, "\n---- loadCellSampler sim: %.3f s at %lu Hz ----\n", secs, mclk);
+	fprintf(stderr, "cpu        active %.1f%%, low power %.1f%%\n",
+			100.0*activeCycles/(now ? now : 1), 100.0*sleepCycles/(now ? now : 1));
+	fprintf(stderr, "hx711      %d chip(s), %lu conversions, %lu read, %lu missed, %lu power-down risks\n",
+			hxCells, hxConv, hxReads, hxMissed, hxPowerDown);
+	fprintf(stderr, "           ready->read latency avg %.0f us, max %.0f us\n",
+			hxReads ? hxLatSum/hxReads : 0, hxLatMax);
+	fprintf(stderr, "uart tx    %lu bytes (%.0f B/s), %lu ascii frames, %lu binary frames, %lu crc errors\n",
+			txBytes, secs > 0 ? txBytes/secs : 0, asciiFrames, binFrames, binCrcErr);
+	fprintf(stderr, "           %.1f frames/s, %lu bytes not taken by host\n",
+			secs > 0 ? (asciiFrames+binFrames)/secs : 0, hostDrops);
+	if(blockFrames)(fprintf(stderr, "           %lu block frames, %lu conversions, %lu seq gaps, %lu hxseq gaps\n",
+			blockFrames, blockSets, blockSeqGaps, hxSeqGaps));
+	if(deltaFrames)(fprintf(stderr, "           %lu delta frames (%lu key), %lu conversions, %.2f B/conversion, %lu seq gaps, %lu hxseq gaps\n",
+			deltaFrames, deltaKeys, deltaSets, (double)deltaBytes/deltaSets, blockSeqGaps, hxSeqGaps));
+	if(eventFrames)(fprintf(stderr, "           %lu event frames, %lu conversions, idx %d..%d\n",
+			eventFrames, eventSets, eventFirst, eventLast));
+	fprintf(stderr, "uart rx    %lu bytes, %lu overruns\n", rxBytes, rxOverruns);
+	fprintf(stderr, "dht        %lu responses\n", dhtStarts);
+	if(&tx_overflow)(fprintf(stderr, "firmware   tx_overflow %u\n", tx_overflow));
+	if(&hxDropped)(fprintf(stderr, "firmware   hxDropped %u\n", hxDropped));
+	if(&statLoopMax)(fprintf(stderr, "firmware   statLoopMax %u ticks, statIsrMax %u ticks\n", statLoopMax, statIsrMax));
+	if(&burstDropped)(fprintf(stderr, "firmware   burstDropped %u\n", burstDropped));
+	if(&rx_overflow)(fprintf(stderr, "firmware   rx_overflow %u, rx_errors %u\n", rx_overflow, rx_errors));
+	plantReport();
+	flashSave();
+	for(v=0; v<V_COUNT; v++){
+		if(isrCount[v]){
+			fprintf(stderr, "isr        %-10s %8lu calls, max %llu cycles\n", vecName[v], isrCount[v], isrMax[v]);
+		}
+	}
+	if(txLog)(fclose(txLog));
+}
+
+__attribute__((constructor))
+static void simInit(void){
+	const char* e;
+	int c;
+
+	if((e = getenv("SIM_SECONDS")))(endSec = atof(e));
+	endTime = (unsigned long long)(endSec * mclk);
+	if((e = getenv("SIM_HX_SPS")))(hxSps = atol(e));
+	if((e = getenv("SIM_BATT_MV")))(battMvSim = atoi(e));
+	if((e = getenv("SIM_HX_CELLS")))(hxCells = atoi(e));
+	if((e = getenv("SIM_IMPACT")))(impactAt = atof(e));
+	if((e = getenv("SIM_PLANT")))(sscanf(e, "%lf,%lf", &plantRate, &plantTau));
+	if((e = getenv("SIM_TEMP")))(tempSet = sscanf(e, "%lf,%lf,%lf", &tempFrom, &tempTo, &tempTco) >= 2);
+	if(plantTau <= 0)(plantTau = 0.05);
+	if(!hxSps)(hxSps = 80);
+	if(hxCells < 1 || hxCells > HX_MAX)(hxCells = 1);
+	for(c=0; c<HX_MAX; c++){
+		hx[c].bit = -1;
+		hx[c].gainNext = hx[c].gainCur = 25;
+		hx[c].dout = 1;
+	}
+	hxResync();
+	flashLoad();
+	rxNext = mclk / 2;
+	srand(1);
+
+	P1IN = SDI | DATA | BIT3;
+	P2IN = 0x3E;
+	uartOpen();
+	atexit(report);
+}
@@ -0,0 +1,238 @@
+/*
+ * sim.h - Host stand-in for the MSP430G2553 device header
+ *
+ * Declares the peripheral registers used by the firmware as plain
+ * variables owned by sim.c, with the bit definitions of msp430g2553.h.
+ * The few registers whose access has side effects (UART buffers, interrupt
+ * vector registers) are routed through functions. Only included through
+ * hal.h when HOST_SIM is defined.
+ *
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#define R8(n)	extern volatile unsigned char n;
+#define R16(n)	extern volatile unsigned short n;
+
+// Special function / clock / watchdog
+R8(IE1) R8(IFG1) R8(IE2) R8(IFG2)
+R8(DCOCTL) R8(BCSCTL1) R8(BCSCTL2) R8(BCSCTL3)
+R8(CALDCO_1MHZ) R8(CALBC1_1MHZ) R8(CALDCO_8MHZ) R8(CALBC1_8MHZ)
+R8(CALDCO_12MHZ) R8(CALBC1_12MHZ) R8(CALDCO_16MHZ) R8(CALBC1_16MHZ)
+R16(WDTCTL)
+
+// Ports
+R8(P1IN) R8(P1OUT) R8(P1DIR) R8(P1IFG) R8(P1IES) R8(P1IE) R8(P1SEL) R8(P1SEL2) R8(P1REN)
+R8(P2IN) R8(P2OUT) R8(P2DIR) R8(P2IFG) R8(P2IES) R8(P2IE) R8(P2SEL) R8(P2SEL2) R8(P2REN)
+
+// Timer0_A3 / Timer1_A3
+R16(TA0CTL) R16(TA0R) R16(TA0CCTL0) R16(TA0CCTL1) R16(TA0CCTL2) R16(TA0CCR0) R16(TA0CCR1) R16(TA0CCR2)
+R16(TA1CTL) R16(TA1R) R16(TA1CCTL0) R16(TA1CCTL1) R16(TA1CCTL2) R16(TA1CCR0) R16(TA1CCR1) R16(TA1CCR2)
+#define TA0IV	(sim_taiv(0))
+#define TA1IV	(sim_taiv(1))
+#define CCR0	TA0CCR0
+#define CCR1	TA0CCR1
+#define CCR2	TA0CCR2
+#define CCTL0	TA0CCTL0
+#define CCTL1	TA0CCTL1
+#define CCTL2	TA0CCTL2
+
+// ADC10
+R16(ADC10CTL0) R16(ADC10CTL1) R16(ADC10MEM) R16(ADC10SA)
+R8(ADC10AE0) R8(ADC10DTC0) R8(ADC10DTC1)
+
+// USCI_A0
+R8(UCA0CTL0) R8(UCA0CTL1) R8(UCA0BR0) R8(UCA0BR1) R8(UCA0MCTL) R8(UCA0STAT)
+#define UCA0TXBUF	(*sim_txbuf())
+#define UCA0RXBUF	(*sim_rxbuf())
+
+// Flash controller, information segments D, C and B (HAL_INFO_x)
+R16(FCTL1) R16(FCTL2) R16(FCTL3)
+extern unsigned char sim_info[0xC0];
+
+#undef R8
+#undef R16
+
+
+// Bits
+#define BIT0	0x0001
+#define BIT1	0x0002
+#define BIT2	0x0004
+#define BIT3	0x0008
+#define BIT4	0x0010
+#define BIT5	0x0020
+#define BIT6	0x0040
+#define BIT7	0x0080
+
+// Status register
+#define GIE			0x0008
+#define CPUOFF		0x0010
+#define OSCOFF		0x0020
+#define SCG0		0x0040
+#define SCG1		0x0080
+#define LPM0_bits	(CPUOFF)
+#define LPM1_bits	(SCG0+CPUOFF)
+#define LPM2_bits	(SCG1+CPUOFF)
+#define LPM3_bits	(SCG1+SCG0+CPUOFF)
+#define LPM4_bits	(SCG1+SCG0+OSCOFF+CPUOFF)
+
+// Basic clock
+#define DIVS_0		0x00
+#define DIVS_1		0x02
+#define DIVS_2		0x04
+#define DIVS_3		0x06
+
+// Watchdog
+#define WDTPW		0x5A00
+#define WDTHOLD		0x0080
+
+// Timer_A
+#define TASSEL_0	0x0000
+#define TASSEL_1	0x0100
+#define TASSEL_2	0x0200
+#define ID_0		0x0000
+#define ID_1		0x0040
+#define ID_2		0x0080
+#define ID_3		0x00C0
+#define MC_0		0x0000
+#define MC_1		0x0010
+#define MC_2		0x0020
+#define MC_3		0x0030
+#define TACLR		0x0004
+#define TAIE		0x0002
+#define TAIFG		0x0001
+#define CM_0		0x0000
+#define CM_1		0x4000
+#define CM_2		0x8000
+#define CM_3		0xC000
+#define CCIS_0		0x0000
+#define CCIS_1		0x1000
+#define CCIS_2		0x2000
+#define CCIS_3		0x3000
+#define SCS			0x0800
+#define SCCI		0x0400
+#define CAP			0x0100
+#define OUTMOD_0	0x0000
+#define OUTMOD_1	0x0020
+#define OUTMOD_4	0x0080
+#define OUTMOD_7	0x00E0
+#define CCIE		0x0010
+#define CCI			0x0008
+#define OUT			0x0004
+#define COV			0x0002
+#define CCIFG		0x0001
+#define TA0IV_NONE		0x0000
+#define TA0IV_TACCR1	0x0002
+#define TA0IV_TACCR2	0x0004
+#define TA0IV_TAIFG		0x000A
+#define TA1IV_NONE		0x0000
+#define TA1IV_TACCR1	0x0002
+#define TA1IV_TACCR2	0x0004
+#define TA1IV_TAIFG		0x000A
+
+// ADC10
+#define SREF_0		0x0000
+#define SREF_1		0x2000
+#define ADC10SHT_0	0x0000
+#define ADC10SHT_1	0x0800
+#define ADC10SHT_2	0x1000
+#define ADC10SHT_3	0x1800
+#define ADC10SR		0x0400
+#define MSC			0x0080
+#define REFON		0x0020
+#define ADC10ON		0x0010
+#define ADC10IE		0x0008
+#define ADC10IFG	0x0004
+#define ENC			0x0002
+#define ADC10SC		0x0001
+#define INCH_0		0x0000
+#define INCH_3		0x3000
+#define INCH_10		0xA000
+#define ADC10DIV_0	0x0000
+#define ADC10SSEL_0	0x0000
+#define CONSEQ_0	0x0000
+#define CONSEQ_1	0x0002
+#define CONSEQ_2	0x0004
+#define CONSEQ_3	0x0006
+#define ADC10BUSY	0x0001
+#define ADC10TB		0x0008
+#define ADC10CT		0x0004
+#define ADC10B1		0x0002
+
+// USCI_A0
+#define UCSSEL_1	0x40
+#define UCSSEL_2	0x80
+#define UCSWRST		0x01
+#define UCOS16		0x01
+#define UCBRS0		0x02
+#define UCBRS_0		0x00
+#define UCBRS_1		0x02
+#define UCBRS_2		0x04
+#define UCBRS_3		0x06
+#define UCBRS_4		0x08
+#define UCBRS_5		0x0A
+#define UCBRS_6		0x0C
+#define UCBRS_7		0x0E
+#define UCOE		0x20
+#define UCBUSY		0x01
+#define UCA0RXIE	0x01
+#define UCA0TXIE	0x02
+#define UCA0RXIFG	0x01
+#define UCA0TXIFG	0x02
+
+// Flash
+#define FWKEY		0xA500
+#define FRKEY		0x9600
+#define ERASE		0x0002
+#define MERAS		0x0004
+#define WRT			0x0040
+#define BLKWRT		0x0080
+#define FSSEL_0		0x0000
+#define FSSEL_1		0x0040
+#define FSSEL_2		0x0080
+#define FN0			0x0001
+#define FN1			0x0002
+#define FN2			0x0004
+#define FN3			0x0008
+#define FN4			0x0010
+#define FN5			0x0020
+#define BUSY		0x0001
+#define KEYV		0x0002
+#define ACCVIFG		0x0004
+#define WAIT		0x0008
+#define LOCK		0x0010
+#define LOCKA		0x0040
+#define FAIL		0x0080
+
+
+// Intrinsics
+#define __delay_cycles(n)				sim_delay(n)
+#define __bis_SR_register(x)			sim_bis_sr(x)
+#define __bic_SR_register(x)			sim_bic_sr(x)
+#define __bis_SR_register_on_exit(x)	sim_bis_sr_on_exit(x)
+#define __bic_SR_register_on_exit(x)	sim_bic_sr_on_exit(x)
+#define __get_SR_register()				sim_get_sr()
+#define __get_SP_register()				sim_sp()
+#define __enable_interrupt()			sim_bis_sr(GIE)
+#define __disable_interrupt()			sim_bic_sr(GIE)
+#define __no_operation()				sim_delay(1)
+#define __even_in_range(x,y)			(x)
+#define __interrupt
+
+
+void sim_delay(unsigned long int);
+void sim_bis_sr(unsigned int);
+void sim_bic_sr(unsigned int);
+void sim_bis_sr_on_exit(unsigned int);
+void sim_bic_sr_on_exit(unsigned int);
+unsigned int sim_get_sr(void);
+unsigned int sim_taiv(int);
+unsigned short sim_addr(void*);
+void sim_flash_wr(unsigned char*, unsigned char);
+unsigned long sim_sp(void);
+volatile unsigned char* sim_txbuf(void);
+volatile unsigned char* sim_rxbuf(void);
+
+
+#endif /* SIM_H_ */
@@ -0,0 +1,80 @@
+/*
+ * statFunks.c
+ *
+ * Collects the counters listed in statFunks.h. Most of them are kept by
+ * the module that sees the error; this file only formats and clears them.
+ *
+ */
+
+#include "statFunks.h"
+#include "loadCellFunks.h"
+#include "serial_handler.h"
+#include "fmtFunks.h"
+
+unsigned int statThTimeout = 0, statThChecksum = 0, statMissed = 0;
+unsigned int statLoopMax = 0, statIsrMax = 0, statIsrId = 0;
+unsigned char statWait = 0;				// a 'K' line is waiting for room in the TX ring
+
+// in the order they are sent
+unsigned int* const statVals[STAT_FIELDS] = {
+		&statThTimeout, &statThChecksum, &statMissed, &hxDropped,
+		&tx_overflow, &rx_overflow, &rx_errors,
+		&statLoopMax, &statIsrMax, &statIsrId
+};
+
+
+/*
+ *  === statDump ===
+ *
+ *  Builds half of the 'K' line in tx_data_str, which is shorter than the
+ *  line: the 'K' and the first STAT_FIELDS/2 values, or the rest with the
+ *  comma in front. Returns its length, without the \n\r added by
+ *  uart_write_string().
+ *
+ */
+int statDump(unsigned char half){
+	unsigned char i, n = 0;
+
+	for(i=half*(STAT_FIELDS/2); i<(half+1)*(STAT_FIELDS/2); i++){
+		tx_data_str[n++] = i ? ',' : 'K';
+		fmtDec(*statVals[i], &tx_data_str[n], 5);
+		n += 5;
+	}
+
+	return n;
+}
+
+
+/*
+ *  === statSend ===
+ *
+ *  Called from the mainloop on every pass. Queues the 'K' line once the
+ *  TX ring has room for all of it, so a frame never splits it and the
+ *  mainloop never waits for the UART.
+ *
+ */
+void statSend(void){
+	if(statWait && uart_tx_room(STAT_LENG+2)){
+		uart_queue(tx_data_str, statDump(0));		// both halves fit, nothing comes between
+		uart_write_string(0, statDump(1));
+		statWait = 0;
+	}
+}
+
+
+/*
+ *  === statReset ===
+ *
+ *  Clears every counter, including those of other modules. Interrupts are
+ *  held off since most of them are counted by interrupt handlers.
+ *
+ */
+void statReset(void){
+	unsigned char i;
+
+	__disable_interrupt();
+	for(i=0; i<STAT_FIELDS; i++){
+		*statVals[i] = 0;
+	}
+	__enable_interrupt();
+}
@@ -0,0 +1,63 @@
+/*
+ * statFunks.h - Instrumentation counters
+ *
+ * Error counters and worst case timings of a running unit. The 'K'
+ * command sends them in one line, 'Z' clears them (see main.c). The line
+ * takes nearly all of the TX ring, so it waits in statWait until the ring
+ * has room for all of it; the values are read when it is queued:
+ *
+ * 		K#####,#####,#####,#####,#####,#####,#####,#####,#####,#####
+ *
+ * 		1	DHT transfers that timed out (statThTimeout)
+ * 		2	DHT transfers with a bad checksum (statThChecksum)
+ * 		3	sample periods that passed without a frame (statMissed)
+ * 		4	HX711 conversions dropped, sample queue full (hxDropped)
+ * 		5	frames dropped, TX ring full (tx_overflow)
+ * 		6	bytes dropped, RX ring full (rx_overflow)
+ * 		7	commands discarded as too long (rx_errors)
+ * 		8	longest mainloop pass, TA1 ticks (statLoopMax)
+ * 		9	longest interrupt, TA1 ticks (statIsrMax)
+ * 		10	the interrupt that took it, STAT_ISR_xxx (statIsrId)
+ *
+ * Counters wrap at 65535. Times are in TA1 ticks (TA_HZ, 4 us, see
+ * clock.h) and include any interrupt that nested in the measured code.
+ * TA1R wraps every 262 ms, so anything longer reads short.
+ *
+ */
+
+#ifndef STATFUNKS_H_
+#define STATFUNKS_H_
+
+#include "hal.h"
+
+#define		STAT_FIELDS		10
+#define		STAT_LENG		(6*STAT_FIELDS)	// 'K' and 5 digits per field, commas between
+
+#define		STAT_ISR_TA1_1	1		// Timer1_A1, sample tick
+#define		STAT_ISR_TA1_0	2		// Timer1_A0, temp/humidity states
+#define		STAT_ISR_PORT1	3		// HX711 cell 0, DHT data line
+#define		STAT_ISR_PORT2	4		// HX711 cells 1-3
+#define		STAT_ISR_ADC	5
+#define		STAT_ISR_TX		6
+#define		STAT_ISR_RX		7
+#define		STAT_ISR_TA0_0	8		// Timer0_A0, output profile steps
+
+// TA1 ticks since t0; the mask keeps the wrap at 16 bits where int is wider (host builds)
+#define		STAT_TICKS(t0)	((TA1R - (t0)) & 0xFFFF)
+
+// first declaration and last statement of an instrumented interrupt
+#define		STAT_ISR_BEGIN	unsigned int statT0 = TA1R
+#define		STAT_ISR_END(id)	do{ unsigned int statDt = STAT_TICKS(statT0); \
+								if(statDt > statIsrMax){ statIsrMax = statDt; statIsrId = (id); } }while(0)
+
+
+extern unsigned int statThTimeout, statThChecksum, statMissed, statLoopMax, statIsrMax, statIsrId;
+
+extern unsigned char statWait;
+
+int statDump(unsigned char);
+void statSend(void);
+void statReset(void);
+
+
+#endif /* STATFUNKS_H_ */
@@ -0,0 +1,213 @@
+/*
+ * tcFunks.c
+ *
+ * Temperature compensation table in information flash, see tcFunks.h.
+ * Only called from the mainloop.
+ *
+ */
+
+#include "tcFunks.h"
+#include "flashFunks.h"
+#include "frameFunks.h"
+#include "thFunks.h"
+
+#define		TC_KEY			0xA5		// an erased segment never checks out
+#define		TC_REC			((const tcRecord*)HAL_INFO_B)
+#define		TC_CHECKED		((unsigned char*)&TC_REC->check - (unsigned char*)TC_REC)	// bytes before check
+
+unsigned char tcState = TC_OFF;
+int tcFrom;									// temperature the ramp started from
+unsigned int tcAt;							// and when, TA1 ticks / 256
+
+static int tcRamp(int, unsigned long, unsigned int);
+static unsigned char tcFrac(unsigned int, unsigned int);
+
+
+/*
+ *  === tcInit ===
+ *
+ *  Turns compensation on if segment B holds a finished table.
+ *
+ */
+void tcInit(void){
+	tcState = ((crc8((unsigned char*)TC_REC, TC_CHECKED) ^ TC_KEY) == TC_REC->check) ? TC_READY : TC_OFF;
+}
+
+
+/*
+ *  === tcBegin ===
+ *
+ *  Starts a new table for source src with its first point at temperature
+ *  t0 and the others step apart. Returns 1 if step is out of range or the
+ *  segment did not erase, compensation is off either way.
+ *
+ */
+int tcBegin(int t0, int step, unsigned char src){
+	tcState = TC_OFF;
+	if(step < 1 || step > TC_STEP_MAX){
+		return 1;
+	}
+	flashErase(HAL_INFO_B);
+	if(flashWrite((unsigned char*)&TC_REC->t0, &t0, 2) || flashWrite((unsigned char*)&TC_REC->step, &step, 2) ||
+			flashWrite((unsigned char*)&TC_REC->src, &src, 1)){
+		return 1;
+	}
+	tcState = TC_LOAD;
+	return 0;
+}
+
+
+/*
+ *  === tcPoint ===
+ *
+ *  Writes point i of cell c, corr counts. Returns 1 if no table is being
+ *  loaded, c or i is out of range, or the point was already written.
+ *
+ */
+int tcPoint(int c, int i, int corr){
+	if(tcState != TC_LOAD || c < 0 || c >= HX_CELLS || i < 0 || i >= TC_N || TC_REC->corr[c][i] != -1){
+		return 1;
+	}
+	return flashWrite((unsigned char*)&TC_REC->corr[c][i], &corr, 2);
+}
+
+
+/*
+ *  === tcEnd ===
+ *
+ *  Finishes the table being loaded. Points never written stay at -1
+ *  counts. Returns 1 if no table is being loaded or the check byte did not
+ *  write.
+ *
+ */
+int tcEnd(void){
+	unsigned char b = crc8((unsigned char*)TC_REC, TC_CHECKED) ^ TC_KEY;
+
+	if(tcState != TC_LOAD || flashWrite((unsigned char*)&TC_REC->check, &b, 1)){
+		return 1;
+	}
+	tcState = TC_READY;
+	return 0;
+}
+
+
+/*
+ *  === tcClear ===
+ *
+ *  Erases the table, compensation off. Returns 1 if the segment did not
+ *  erase.
+ *
+ */
+int tcClear(void){
+	tcState = TC_OFF;
+	flashErase(HAL_INFO_B);
+	return TC_REC->check != 0xFF;
+}
+
+
+/*
+ *  === tcReading ===
+ *
+ *  Called after each good DHT reading, with the reading before it (old),
+ *  the time and the rest period in TA1 ticks / 256. The ramp toward the new
+ *  reading starts from the temperature in effect.
+ *
+ */
+void tcReading(int old, unsigned long time, unsigned int span){
+	if(tcState == TC_READY){
+		tcFrom = thTemp();							// first reading, no ramp
+		tcState = TC_ON;
+	}
+	else if(tcState == TC_ON){
+		tcFrom = tcRamp(old, time, span);
+	}
+	tcAt = (time >> 8) & 0xFFFF;
+}
+
+
+/*
+ *  === tcActive ===
+ *
+ *  Returns 1 if the loads of source src are compensated.
+ *
+ */
+unsigned char tcActive(unsigned char src){
+	return tcState == TC_ON && TC_REC->src == src;
+}
+
+
+/*
+ *  === tcApply ===
+ *
+ *  Compensates the loads of the table's source (sign extended counts, one
+ *  per cell) taken at time, span as for tcReading. load and out may be
+ *  the same, the results are sign extended as well.
+ *
+ */
+void tcApply(long int* load, long int* out, unsigned long time, unsigned int span){
+	long int x = (long int)tcRamp(thTemp(), time, span) - TC_REC->t0, corr;
+	unsigned char c, i = 0, frac = 0;
+
+	if(x >= (TC_N-1) * TC_REC->step){		// within an int, see TC_STEP_MAX
+		i = TC_N-1;
+	}
+	else if(x > 0){
+		i = (unsigned int)x / TC_REC->step;
+		frac = tcFrac((unsigned int)x % TC_REC->step, TC_REC->step);
+	}
+
+	for(c=0; c<HX_CELLS; c++){
+		corr = TC_REC->corr[c][i];
+		if(frac)(corr += ((TC_REC->corr[c][i+1] - corr) * frac) >> 8);
+		x = load[c] - corr;
+		if(x > 0x007FFFFFL)(x = 0x007FFFFFL);
+		if(x < -0x007FFFFFL)(x = -0x007FFFFFL);
+		out[c] = x;
+	}
+}
+
+
+/*
+ *  === tcRamp ===
+ *
+ *  The temperature in effect at time: on the ramp from tcFrom to the
+ *  reading 'to', which takes span from the last reading.
+ *
+ */
+static int tcRamp(int to, unsigned long time, unsigned int span){
+	unsigned int dt = ((time >> 8) - tcAt) & 0xFFFF;
+
+	if(dt >= span){
+		tcFrom = to;				// ramp done, also before dt wraps
+		return to;
+	}
+	dt = tcFrac(dt, span);
+	to -= tcFrom;						// a few hundred at most in the sensor's range
+
+	// to * dt >> 8 in two halves, no long multiply
+	return tcFrom + (to >> 8) * (int)dt + (((to & 0xFF) * dt) >> 8);
+}
+
+
+/*
+ *  === tcFrac ===
+ *
+ *  Returns n / d in 1/256 for n < d, by long division: no 32-bit divide,
+ *  which would take more stack than the rest of tcApply.
+ *
+ */
+static unsigned char tcFrac(unsigned int n, unsigned int d){
+	unsigned char f = 0, k;
+
+	for(k=0; k<8; k++){
+		f <<= 1;
+		if(n >= d - n){						// 2n >= d, without overflowing n
+			n -= d - n;
+			f |= 1;
+		}
+		else{
+			n <<= 1;
+		}
+	}
+	return f;
+}
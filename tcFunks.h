@@ -0,0 +1,68 @@
+/*
+ * tcFunks.h - Temperature compensation of the loads
+ *
+ * Takes the zero drift of the bridges with temperature out of the loads
+ * of the frames, per cell:
+ *
+ * 		load = counts - corr(T)
+ *
+ * corr is piecewise linear in counts over TC_N points at t0, t0+step, ...
+ * and held at the end points outside of them. T is the DHT reading in the
+ * unit of the frames' temperature field (thTemp, 0.1 C), and so are t0 and
+ * step, so a table fit from recorded frames (host/lcsTcFit) always matches.
+ *
+ * The sensor only reads every DHT rest period (T command). Rather than
+ * step at each reading, T ramps linearly from the value in effect to the
+ * new reading over one rest period, so every frame gets its own
+ * correction and lags the reading by at most one period.
+ *
+ * The table is written point by point straight into information segment
+ * B (flashFunks.h) and read in place, it takes no RAM:
+ *
+ * 		tcBegin		erases the segment and sets the grid, compensation off
+ * 		tcPoint		writes one point, each can only be written once
+ * 		tcEnd		writes the check byte, compensation is on from the next
+ * 					reading, and after every reset
+ * 		tcClear		erases the segment, compensation off
+ *
+ * It belongs to the source that was first in the C list at tcBegin.
+ * Compensation runs before the conversion to grams or mN (calFunks.h); raw
+ * conversions, the trigger and the force controller stay uncompensated.
+ *
+ */
+
+#ifndef TCFUNKS_H_
+#define TCFUNKS_H_
+
+#include "loadCellFunks.h"
+
+#define		TC_N			7			// points per cell
+#define		TC_STEP_MAX		5000		// (TC_N-1) * step within an int
+
+#define		TC_OFF			0			// tcState, no table
+#define		TC_LOAD			1			// between tcBegin and tcEnd
+#define		TC_READY		2			// table valid, no reading yet
+#define		TC_ON			3
+
+
+// short: 16 bits on the simulator's host too, so the record fits a segment there
+typedef struct {
+	short corr[HX_CELLS][TC_N];			// counts, TC_N * HX_CELLS * 2 <= 56 bytes
+	short t0, step;						// temperature of the first point, between points
+	unsigned char src;					// HX_SRC() the table applies to
+	unsigned char check;				// crc8 of the bytes before ^ TC_KEY, last member
+} tcRecord;
+
+extern unsigned char tcState;
+
+void tcInit(void);
+int tcBegin(int, int, unsigned char);
+int tcPoint(int, int, int);
+int tcEnd(void);
+int tcClear(void);
+void tcReading(int, unsigned long, unsigned int);
+unsigned char tcActive(unsigned char);
+void tcApply(long int*, long int*, unsigned long, unsigned int);
+
+
+#endif /* TCFUNKS_H_ */
@@ -0,0 +1,267 @@
+/*
+ * filtTest.c - Host check of the decimation filter (filtFunks.h)
+ *
+ * Runs filtPush on the host against two references for every rate and
+ * order the firmware accepts:
+ *
+ * 		exact	the same two roundings in 64-bit arithmetic (group average
+ * 				half away from zero, FIR half up), so the output must match
+ * 				bit for bit
+ * 		ideal	the filter as a single rational FIR over the conversions,
+ * 				which the output may miss by one count at most
+ *
+ * plus DC gain, rounding, decimation phase, negative inputs and the
+ * rejected configurations on their own. Cell 0 and cell 1 get different
+ * inputs to show the cells do not share state. Prints the failures and
+ * exits with 1 if there are any.
+ *
+ * Build and run with "make" in this directory.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "filtFunks.h"
+#include "burstFunks.h"
+
+#define NCONV	(FILT_MAX_RATE*(FILT_MAX_ORDER+4))	// conversions per run
+
+burstMem burstBuf;						// holds the filter history, burstFunks.c in the firmware
+long checks = 0, failed = 0;
+unsigned long seed = 1;
+
+void check(int ok, const char* what, int rate, int order, long got, long want){
+	checks++;
+	if(ok){
+		return;
+	}
+	if(++failed <= 20){
+		printf("FAIL %s: D%03d O%03d got %ld want %ld\n", what, rate, order, got, want);
+	}
+}
+
+long from24(long x){
+	x &= 0x00FFFFFF;
+	return (x & 0x00800000) ? x - 0x01000000 : x;
+}
+
+long binom(int n, int k){
+	long b = 1;
+	int i;
+
+	for(i=0; i<k; i++){
+		b = b*(n-i)/(i+1);
+	}
+	return b;
+}
+
+long rand24(void){
+	seed = seed*1103515245 + 12345;
+	return from24(seed >> 8);
+}
+
+/*
+ *  === run ===
+ *
+ *  Configures the filter and pushes n conversions, cell c getting x[c][i].
+ *  Writes the outputs to y[c][] and returns how many there were, or -1 if
+ *  an output did not come on every rate-th conversion.
+ *
+ */
+int run(int rate, int order, long x[2][NCONV], int n, long y[2][NCONV]){
+	long in[HX_CELLS], out[HX_CELLS];
+	int i, c, k = 0;
+
+	if(filtConfig(rate, order)){
+		return -1;
+	}
+	for(i=0; i<n; i++){
+		for(c=0; c<HX_CELLS; c++){
+			in[c] = x[c&1][i];				// sign extended, as hxPop returns them
+		}
+		if(filtPush(in, out) != ((i+1) % rate == 0)){
+			return -1;
+		}
+		if((i+1) % rate == 0){
+			for(c=0; c<2; c++){
+				y[c][k] = out[c];
+			}
+			k++;
+		}
+	}
+	return k;
+}
+
+/*
+ *  === reference ===
+ *
+ *  Output k of the exact (mode 0) or ideal (mode 1) reference for the
+ *  conversions x[], with zeros before the first one.
+ *
+ */
+double reference(int mode, int rate, int order, long* x, int k){
+	long long avg, sum = 0, acc;
+	double ideal = 0;
+	int j, i, g;
+	long coef;
+
+	for(j=0; j<=order; j++){
+		g = k - order + j;					// group of tap j, oldest first
+		if(g < 0){
+			continue;
+		}
+		coef = binom(order, j);
+		for(acc=0, i=g*rate; i<(g+1)*rate; i++){
+			acc += x[i];
+		}
+		ideal += (double)coef*acc/rate;
+		avg = (acc < 0) ? -((-acc + rate/2)/rate) : (acc + rate/2)/rate;
+		sum += coef*avg;
+	}
+	if(mode == 1){
+		return ideal/(1L << order);
+	}
+	if(order > 0){
+		sum = (sum + (1LL << (order-1))) >> order;
+	}
+	return sum;
+}
+
+void testReference(void){
+	static long x[2][NCONV], y[2][NCONV];
+	int rate, order, n, k, c, i;
+	double d;
+
+	for(rate=1; rate<=FILT_MAX_RATE; rate++){
+		for(order=0; order<=FILT_MAX_ORDER; order++){
+			for(i=0; i<NCONV; i++){
+				x[0][i] = rand24();
+				x[1][i] = (i % 7 < 3) ? rand24() >> 12 : -(rand24() >> 4);	// small and negative
+			}
+			n = run(rate, order, x, NCONV, y);
+			check(n == NCONV/rate, "output count", rate, order, n, NCONV/rate);
+			for(c=0; c<2; c++){
+				for(k=0; k<n; k++){
+					check(y[c][k] == (long)reference(0, rate, order, x[c], k),
+							"exact", rate, order, y[c][k], (long)reference(0, rate, order, x[c], k));
+					d = y[c][k] - reference(1, rate, order, x[c], k);
+					check(d <= 1 && d >= -1, "ideal", rate, order, y[c][k], (long)reference(1, rate, order, x[c], k));
+				}
+			}
+		}
+	}
+}
+
+void testDcGain(void){
+	static long x[2][NCONV], y[2][NCONV];
+	const long level[] = {0, 1, -1, 12345, -777, 0x7FFFFF, -0x800000};
+	int rate, order, n, k, l, i;
+
+	for(rate=1; rate<=FILT_MAX_RATE; rate++){
+		for(order=0; order<=FILT_MAX_ORDER; order++){
+			for(l=0; l<sizeof(level)/sizeof(level[0]); l++){
+				for(i=0; i<NCONV; i++){
+					x[0][i] = level[l];
+					x[1][i] = -1 - level[l];
+				}
+				n = run(rate, order, x, NCONV, y);
+				for(k=order; k<n; k++){				// once the history is full
+					check(y[0][k] == level[l], "dc gain", rate, order, y[0][k], level[l]);
+					check(y[1][k] == -1 - level[l], "dc gain", rate, order, y[1][k], -1 - level[l]);
+				}
+			}
+		}
+	}
+}
+
+void testRounding(void){
+	static long x[2][NCONV], y[2][NCONV];
+	static const struct {
+		int rate, order;
+		long in[4], out;
+	} r[] = {
+		{2, 0, {1, 0}, 1},				// group average: half away from zero
+		{2, 0, {-1, 0}, -1},
+		{4, 0, {1, 0, 0, 0}, 0},
+		{4, 0, {-1, 0, 0, 0}, 0},
+		{4, 0, {1, 1, 1, 0}, 1},
+		{4, 0, {-1, -1, -1, 0}, -1},
+		{3, 0, {1, 1, 0}, 1},
+		{3, 0, {-1, -1, 0}, -1},
+		{1, 1, {1}, 1},					// FIR: half up
+		{1, 1, {-1}, 0},
+		{1, 2, {1}, 0},
+		{1, 2, {2}, 1},
+		{1, 2, {-2}, 0},
+		{1, 2, {-3}, -1},
+	};
+	int t, i, n;
+
+	for(t=0; t<sizeof(r)/sizeof(r[0]); t++){
+		for(i=0; i<NCONV; i++){
+			x[0][i] = (i < 4) ? r[t].in[i] : 0;
+			x[1][i] = 0;
+		}
+		n = run(r[t].rate, r[t].order, x, r[t].rate, y);
+		check(n == 1 && y[0][0] == r[t].out, "rounding", r[t].rate, r[t].order, y[0][0], r[t].out);
+	}
+}
+
+void testPhase(void){
+	static long x[2][NCONV], y[2][NCONV];
+	int rate, order, p, n, k, j;
+	long want;
+
+	// an impulse at conversion p lands in output p/rate and the order after it
+	for(rate=1; rate<=FILT_MAX_RATE; rate++){
+		for(order=0; order<=FILT_MAX_ORDER; order++){
+			for(p=0; p<2*rate; p++){
+				for(k=0; k<NCONV; k++){
+					x[0][k] = (k == p) ? (long)rate*(1L << order)*64 : 0;
+					x[1][k] = -x[0][k];
+				}
+				n = run(rate, order, x, NCONV, y);
+				for(k=0; k<n; k++){
+					j = k - p/rate;
+					want = (j >= 0 && j <= order) ? binom(order, j)*64 : 0;
+					check(y[0][k] == want, "phase", rate, order, y[0][k], want);
+					check(y[1][k] == -want, "phase", rate, order, y[1][k], -want);
+				}
+			}
+		}
+	}
+}
+
+void testConfig(void){
+	static long x[2][NCONV], y[2][NCONV];
+	static const int bad[][2] = {{0, 0}, {-1, 0}, {FILT_MAX_RATE+1, 0}, {1, -1}, {1, FILT_MAX_ORDER+1}, {255, 255}};
+	int t, i, n;
+
+	check(filtConfig(5, 3) == 0, "config", 5, 3, 1, 0);
+	for(t=0; t<sizeof(bad)/sizeof(bad[0]); t++){
+		check(filtConfig(bad[t][0], bad[t][1]) == 1, "rejected", bad[t][0], bad[t][1], 0, 1);
+		check(filtRate == 5 && filtOrder == 3, "unchanged", filtRate, filtOrder, 0, 0);
+	}
+
+	// a new configuration starts from zero
+	for(i=0; i<NCONV; i++){
+		x[0][i] = x[1][i] = 100000;
+	}
+	run(3, 2, x, NCONV, y);
+	for(i=0; i<NCONV; i++){
+		x[0][i] = x[1][i] = (i < 3) ? 1024 : 0;
+	}
+	n = run(3, 2, x, 9, y);
+	check(n == 3 && y[0][0] == 256 && y[0][1] == 512 && y[0][2] == 256, "restart", 3, 2, y[0][0], 256);
+}
+
+int main(void){
+	testReference();
+	testDcGain();
+	testRounding();
+	testPhase();
+	testConfig();
+
+	printf("filtTest: %ld checks, %ld failed\n", checks, failed);
+	return failed != 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * fmtTest.c - Host check of the decimal formatting (fmtFunks.h)
+ *
+ * Compares fmtDec and fmtSigned with sprintf:
+ *
+ * 		every value below 2^24 (a load field) at 10 and 8 digits
+ * 		every 16-bit value at each width from 1 to 10 digits
+ * 		the powers of ten and of two, +-1, and random 32-bit values at
+ * 		each width
+ *
+ * fmtDec does its last digits in unsigned short, 16 bits here as on the
+ * MSP430. Guard bytes on both sides of the field catch writes outside it.
+ * Prints the failures and exits with 1 if there are any.
+ *
+ * Build and run with "make" in this directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "fmtFunks.h"
+
+#define GUARD	0xA5
+
+long checks = 0, failed = 0;
+unsigned long seed = 1;
+
+/*
+ *  === checkDec ===
+ *
+ *  Formats val with fmtDec (sign 0) or fmtSigned (sign 1) at the given
+ *  width and compares it with the lowest digits of sprintf.
+ *
+ */
+void checkDec(long long val, unsigned char digits, int sign){
+	unsigned char buf[16], want[24];
+	char ref[24];
+	unsigned char n = digits + sign, i;
+
+	memset(buf, GUARD, sizeof(buf));
+	if(sign){
+		fmtSigned((long int)val, &buf[2], digits);
+		sprintf(ref, "%020llu", val < 0 ? -val : val);
+		want[0] = (val < 0) ? '-' : '0';
+	}
+	else{
+		fmtDec((unsigned long int)val, &buf[2], digits);
+		sprintf(ref, "%020llu", val);
+	}
+	memcpy(&want[sign], &ref[20-digits], digits);
+
+	checks++;
+	for(i=0; i<sizeof(buf); i++){
+		if(i < 2 || i >= 2+n ? buf[i] != GUARD : buf[i] != want[i-2]){
+			break;
+		}
+	}
+	if(i < sizeof(buf) && ++failed <= 20){
+		printf("FAIL %s(%lld, %d): got \"%.*s\" want \"%.*s\"\n", sign ? "fmtSigned" : "fmtDec",
+				val, digits, n, (char*)&buf[2], n, (char*)want);
+	}
+}
+
+unsigned long rand32(void){
+	seed = seed*6364136223846793005ULL + 1442695040888963407ULL;
+	return seed >> 32;
+}
+
+int main(void){
+	long long v, p;
+	unsigned char d;
+	int i;
+
+	for(v=0; v<(1L << 24); v++){
+		checkDec(v, 10, 0);
+		checkDec(v, 8, 0);
+	}
+	for(d=1; d<=10; d++){
+		for(v=0; v<65536; v++){
+			checkDec(v, d, 0);
+		}
+		for(p=1; p<=4294967295LL; p*=10){
+			for(v=p-1; v<=p+1; v++){
+				checkDec(v, d, 0);
+			}
+		}
+		for(p=1; p<=4294967296LL; p*=2){
+			for(v=p-1; v<=p+1 && v<=4294967295LL; v++){
+				checkDec(v, d, 0);
+			}
+		}
+		for(i=0; i<100000; i++){
+			checkDec(rand32(), d, 0);
+		}
+	}
+
+	for(v=-(1L << 23); v<(1L << 23); v+=7){			// the load and temperature fields
+		checkDec(v, 8, 1);
+	}
+	for(v=-65536; v<=65536; v++){
+		checkDec(v, 4, 1);
+	}
+
+	printf("fmtTest: %ld checks, %ld failed\n", checks, failed);
+	return failed != 0;
+}
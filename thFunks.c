@@ -4,29 +4,46 @@
  *  Created on: May 29, 2019
  *      Author: bhunt
  *
- * Samples a DHT11 temperature and humidity sensor. The mainloop (CHANGE?)
- * dictates the states of the device as follows:
+ * Samples a DHT11 temperature and humidity sensor. The mainloop and the
+ * Timer1 A0 interrupt dictate the states of the device as follows:
  *
  * 		State 0:	device is ready to be woken
- * 		State 1:	device is ready to sample
+ * 		State 1:	device is sending, bits decoded by thEdge()
  * 		State 2:	wait while device is waking
  * 		State 3:	wait while device sleeps
+ * 		State 4:	transfer finished, result collected by thRead()
+ *
+ * The data line is never polled. Once the start pulse is released every
+ * falling edge raises a port 1 interrupt and thEdge() timestamps it with
+ * TA1R. The time between falling edges is 50 us low plus 26-28 us high for
+ * a 0 and 70 us high for a 1, so each interval decodes to one bit:
+ *
+ * 		edge 0		sensor response (80 us low, 80 us high)
+ * 		edge 1		start of bit 0
+ * 		edge n+1	end of bit n-1, start of bit n
+ * 		edge 41		end of bit 39
  *
  *
  */
 
-#include <msp430.h>
+#include "hal.h"
 #include "thFunks.h"
+#include "events.h"
+#include "statFunks.h"
 
-#define HOLD __delay_cycles(0x0FF);
-#define  CHK_TO	if(TA1R>(tic+30)){ P1DIR |= DATA; return 1;}
+#define HOLD __delay_cycles(CYCLES_US(250));
 
 
-volatile char thBuffer[5] = { 0 }, restFlag = 0;		// change to char when
+volatile char thBuffer[4] = { 0 };			// last good reading, without the checksum
+volatile char thRaw[5];
+volatile unsigned char thEdgeCnt = 0, thStatus = TH_OK;
+volatile unsigned int thLastEdge;
 
 // initialize function
 void thInit(){
 	P1DIR |= DATA;
+	P1IES |= DATA;		// falling edges only
+	P1IE &= ~DATA;
 }
 
 void thStart(){
@@ -38,75 +55,116 @@ void thStart(){
 	P1OUT &= ~DATA;
 
 	// wait for 18 ms (unobtrusive, frees CPU)
-	TA1CCR0 = TA1R+5000;		// 18 ms * 250 kHz = 4500 cycles
+	TA1CCR0 = TA1R+TH_START;
 }
 
-int thRead(){
-	unsigned char thNdx, bit, checkSum;
-	unsigned int tic;
-
-	TA1CCTL2 &= ~CCIE;
-//	P1OUT |= DATA;
-//	__delay_cycles(5);
-
-	P1DIR &= ~DATA;		// switch dataline to input
-	__delay_cycles(5);
-	// ignore first DHT pulse
-	tic = TA1R;
-	while(P1IN & DATA){	// trap line, wait to go low
-		CHK_TO
-	}
-	__delay_cycles(5);
 
-	tic = TA1R;
-	while(!(P1IN & DATA)){	// trap line, wait to go high
-		CHK_TO
-	}
-	__delay_cycles(5);
+/*
+ *  === thArm ===
+ *
+ *  Called from the Timer1 A0 interrupt once the start pulse is long enough.
+ *  Releases the line and enables the falling edge interrupt; the transfer
+ *  must finish before TA1CCR0 fires again or it is aborted by thAbort().
+ *
+ */
+void thArm(){
+	thEdgeCnt = 0;
+	P1IFG &= ~DATA;
+	P1IE |= DATA;
+	P1DIR &= ~DATA;		// switch dataline to input, pulled up
 
-	tic = TA1R;
-	while(P1IN & DATA){	// trap line again
-		CHK_TO
-	}
-	__delay_cycles(5);
+	TA1CCR0 = TA1R+TH_TIMEOUT;
+}
 
-	for(thNdx=0; thNdx<5; thNdx++){		// for ( each pos in array ) ...
-		thBuffer[thNdx] = 0;
-		P1OUT ^= BIT0;
-		for(bit=0; bit<8; bit++){		// for ( each bit in byte ) ...
-			thBuffer[thNdx] <<= 1;
 
-			tic = TA1R;
-			while(!(P1IN & DATA)){		// hold while line low, wait to go high
-				CHK_TO
-			}
+/*
+ *  === thEdge ===
+ *
+ *  Port 1 interrupt handler for the data line. Converts the time since
+ *  the previous falling edge to a bit of thRaw.
+ *
+ */
+void thEdge(){
+	unsigned int now = TA1R;
+	unsigned char n;
 
-			__delay_cycles(28);			// threshold time; if line is 0 at this time, data is 0; else, 1
+	P1IFG &= ~DATA;
 
-//			tic = TA1R;
-//			while(TA1R<(tic+6));		// hold for length of clock pulse
+	if(thEdgeCnt >= 2){
+		n = thEdgeCnt-2;		// bit number
+		thRaw[n>>3] <<= 1;
+		if(((now-thLastEdge) & 0xFFFF) > TH_BIT_THRESH){	// TA1R wraps at 16 bits
+			thRaw[n>>3] |= 1;
+		}
+	}
+	thLastEdge = now;
+
+	if(++thEdgeCnt == TH_EDGES){
+		P1IE &= ~DATA;
+		P1DIR |= DATA;			// return to output
+		thStatus = TH_OK;
+		TA1CCR0 = TA1R+0xFFFF;	// maximum integer value
+		thState = 4;
+		events |= EV_TH;
+	}
+}
 
-			if(P1IN&DATA)(thBuffer[thNdx] |= 1);
-			while(P1IN & DATA){
-				CHK_TO
-			}
 
-		}
+/*
+ *  === thAbort ===
+ *
+ *  Called from the Timer1 A0 interrupt if the sensor stopped sending.
+ *
+ */
+void thAbort(){
+	P1IE &= ~DATA;
+	P1DIR |= DATA;
+	thStatus = TH_TIMEOUT_ERR;
+	thState = 4;
+	events |= EV_TH;
+}
 
-	}
 
-	checkSum = thBuffer[0]+thBuffer[1]+thBuffer[2]+thBuffer[3];
+/*
+ *  === thRead ===
+ *
+ *  Collects the result of a finished transfer (state 4). thBuffer is only
+ *  updated if the checksum passes. Returns 1 on timeout or checksum error.
+ *
+ */
+int thRead(){
+	unsigned char checkSum;
 
-	if(checkSum != thBuffer[4]){
-		P1DIR |= DATA;
+	if(thStatus != TH_OK){
+		statThTimeout++;
 		return 1;
 	}
 
+	checkSum = thRaw[0]+thRaw[1]+thRaw[2]+thRaw[3];
 
-	P1DIR |= DATA;		// return to output
-	TA1CCR0 = TA1R+0xFFFF;	// maximum integer value
-	restFlag = 1;
+	if(checkSum != (unsigned char)thRaw[4]){
+		thStatus = TH_CHECKSUM;
+		statThChecksum++;
+		return 1;
+	}
+
+	for(checkSum=0; checkSum<4; checkSum++){
+		thBuffer[checkSum] = thRaw[checkSum];
+	}
 	return 0;
 
 }
 
+
+/*
+ *  === thTemp ===
+ *
+ *  Returns the temperature of the last good reading as the frames carry
+ *  it: 16 bits, bit 15 the sign, 0.1 C for the DHT22 style reading.
+ *
+ */
+int thTemp(void){
+	unsigned int t = ((unsigned char)thBuffer[2] << 8) | (unsigned char)thBuffer[3];
+
+	return (t & 0x8000) ? -(int)(t & 0x7FFF) : (int)t;
+}
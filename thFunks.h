@@ -9,14 +9,38 @@
 #ifndef THFUNKS_H_
 #define THFUNKS_H_
 
+#include "clock.h"
+
 #define	 DATA	0x80
 
+// in TA1 ticks, see clock.h
+#define	 TH_START		TA_US(20000)	// start pulse, at least 18 ms
+#define	 TH_BIT_THRESH	TA_US(100)		// between falling edges, longer is a 1
+#define	 TH_TIMEOUT		TA_US(6000)		// a full transfer takes at most 5 ms
+#define	 TH_EDGES		42		// response edge, bit 0 start, 40 bit ends
+
+#define	 TH_OK			0
+#define	 TH_TIMEOUT_ERR	1
+#define	 TH_CHECKSUM	2
+
+
+// a 0 bit is 50 + 26-28 us between falling edges, a 1 50 + 70 us
+CLK_ASSERT(TH_START >= TA_US(18000) && TH_START <= 0xFFFF, th_start_pulse);
+CLK_ASSERT(TH_BIT_THRESH > TA_US(78) && TH_BIT_THRESH < TA_US(120), th_bit_threshold);
+CLK_ASSERT(TH_TIMEOUT > TA_US(5000) && TH_TIMEOUT <= 0xFFFF, th_timeout);
+
 
-extern volatile char thBuffer[5], restFlag, sampNdx;
+extern volatile char thBuffer[4];
+extern volatile unsigned char thStatus;
+extern volatile unsigned char thState;
 
 void thInit();
 void thStart();
+void thArm();
+void thEdge();
+void thAbort();
 int thRead();
+int thTemp(void);
 
 
 #endif /* THFUNKS_H_ */
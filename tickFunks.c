@@ -0,0 +1,28 @@
+/*
+ * tickFunks.c
+ *
+ * TA1R extension, see tickFunks.h.
+ *
+ */
+
+#include "tickFunks.h"
+
+volatile unsigned int tickHigh = 0;			// TA1 overflows, counted in Timer1_A1 (main.c)
+
+
+/*
+ *  === tickNow ===
+ *
+ *  Returns the current 32-bit tick count. Must be called with interrupts
+ *  disabled, as from an interrupt handler: an overflow that is pending but
+ *  not yet counted shows as TAIFG and a small TA1R.
+ *
+ */
+unsigned long tickNow(void){
+	unsigned int hi = tickHigh, lo = TA1R;
+
+	if((TA1CTL & TAIFG) && lo < 0x8000){
+		hi++;
+	}
+	return ((unsigned long)hi << 16) | lo;
+}
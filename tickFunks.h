@@ -0,0 +1,23 @@
+/*
+ * tickFunks.h - 32-bit time base
+ *
+ * TA1 runs continuously at TA_HZ (250 kHz, see clock.h). Its overflows
+ * are counted in tickHigh by the Timer1 A1 interrupt (TAIFG), which
+ * extends TA1R to a 32-bit tick count that wraps after 4.7 hours. HX711
+ * conversions are stamped with it (hxIsr) and the stamps are sent in
+ * every frame, see frameFunks.h.
+ *
+ */
+
+#ifndef TICKFUNKS_H_
+#define TICKFUNKS_H_
+
+#include "hal.h"
+
+
+extern volatile unsigned int tickHigh;
+
+unsigned long tickNow(void);
+
+
+#endif /* TICKFUNKS_H_ */